@@ -0,0 +1,480 @@
+#include "SparseMatrix.hpp"
+#include "BlockSparseMatrix.hpp"
+#include "SellMatrix.hpp"
+#include "AssemblyArena.hpp"
+#include "SymmetricSparseMatrix.hpp"
+#include "matrixGenerators.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <optional>
+#include <fstream>
+#include <random>
+#include <span>
+#include <string>
+#include <vector>
+
+using namespace algebra;
+
+/*
+ * Benchmark of the SparseMatrix operations on synthetic matrices (banded, random uniform, power-law rows,
+ * 27-point FEM stencil, the same with a random numbering) and on MatrixMarket files, in both storage orders.
+ * The products also run with the values stored in float and bfloat16 and accumulated in double (see castValues),
+ * in the block format with 3x3 blocks (see BlockSparseMatrix, if it stores at most 4 values per element) and in SELL-8-sigma (see SellMatrix); product<SquareShape> and
+ * dot run on the matrix and on its rows summed in one column. The elements are also inserted one by one in random order,
+ * with both assembly backends and the memory from the default resource or from an AssemblyArena, then compressed.
+ * The square matrices are multiplied by themselves (sparseProduct), up to --product-limit multiplications. The matrices
+ * without non-zero elements are skipped.
+ * The symmetric matrices are also multiplied from their upper triangle (see SymmetricSparseMatrix).
+ * The square matrices are also reordered (reverse Cuthill-McKee and recursive bisection) and multiplied again, and
+ * every record reports the bandwidth and the profile of the matrix it ran on. Every case runs warmup repetitions, then timed repetitions;
+ * the median, mean, standard deviation and minimum of the times are written in CSV (default) or JSON on the
+ * standard output, with GFLOP/s and the effective GB/s computed on the median. Progress goes to the standard error.
+ *
+ * usage: ./benchmark [--nnz=N] [--per-row=N] [--warmup=N] [--reps=N] [--threads=N] [--format=csv|json]
+ *                    [--generators=banded,random,powerlaw,fem,fem_shuffled] [--uncompressed-limit=N] [--product-limit=N] [--mtx=file[,file]]
+ */
+
+namespace{
+
+struct Options{
+    std::size_t nnz= 1'000'000;                 //target number of non-zero elements of every matrix
+    std::size_t per_row= 16;                    //mean number of elements per row, not for fem
+    int warmup= 2;
+    int reps= 10;
+    std::size_t threads= 0;                     //threads of parallelProduct, 0 means one per hardware thread
+    bool json= false;
+    std::string generators= "banded,random,powerlaw,fem,fem_shuffled";
+    std::string mtx_files;                      //comma-separated MatrixMarket files
+    std::size_t uncompressed_limit= 10'000'000; //the uncompressed cases are skipped above this nnz
+    std::size_t product_limit= 100'000'000;     //sparseProduct is skipped above this number of multiplications
+};
+
+struct Stats{
+    double min=0, median=0, mean=0, stddev=0;
+};
+
+struct Record{
+    std::string generator, storage, operation;
+    std::size_t rows, cols, nnz;
+    std::size_t bandwidth, profile;
+    int reps;
+    Stats seconds;
+    double flops;   //floating point operations of one repetition
+    double bytes;   //bytes read and written by one repetition, at least once
+};
+
+using Clock= std::chrono::steady_clock;
+
+/**
+ * \brief Times run after setup (not timed), warmup times without recording and reps times recording
+ */
+template <class Setup, class Run>
+Stats measure(const Options &options, Setup setup, Run run){
+    for(int r=0; r<options.warmup; ++r){
+        setup();
+        run();
+    }
+    std::vector<double> times;
+    for(int r=0; r<options.reps; ++r){
+        setup();
+        auto start= Clock::now();
+        run();
+        times.push_back(std::chrono::duration<double>(Clock::now()-start).count());
+    }
+    Stats stats;
+    if(times.empty())
+        return stats;
+    std::sort(times.begin(), times.end());
+    std::size_t n= times.size();
+    stats.min= times.front();
+    stats.median= n%2 ? times[n/2] : (times[n/2-1]+times[n/2])/2;
+    for(double t: times)
+        stats.mean+= t/n;
+    for(double t: times)
+        stats.stddev+= (t-stats.mean)*(t-stats.mean)/n;
+    stats.stddev= std::sqrt(stats.stddev);
+    return stats;
+}
+
+template <class Run>
+Stats measure(const Options &options, Run run){
+    return measure(options, []{}, run);
+}
+
+//the result of an operation is kept alive, so that the compiler does not remove it
+volatile double sink;
+
+void printRecords(const std::vector<Record> &records, bool json){
+    auto gflops= [](const Record &r){ return r.flops/r.seconds.median/1e9; };
+    auto gbytes= [](const Record &r){ return r.bytes/r.seconds.median/1e9; };
+    if(json){
+        std::printf("[\n");
+        for(std::size_t i=0; i<records.size(); ++i){
+            const Record &r= records[i];
+            std::printf("  {\"generator\": \"%s\", \"storage\": \"%s\", \"operation\": \"%s\", \"rows\": %zu, \"cols\": %zu, "
+                        "\"nnz\": %zu, \"bandwidth\": %zu, \"profile\": %zu, \"reps\": %d, \"median_s\": %.9g, \"mean_s\": %.9g, \"stddev_s\": %.9g, \"min_s\": %.9g, "
+                        "\"gflops\": %.6g, \"gbytes_per_s\": %.6g}%s\n",
+                        r.generator.c_str(), r.storage.c_str(), r.operation.c_str(), r.rows, r.cols, r.nnz, r.bandwidth,
+                        r.profile, r.reps, r.seconds.median, r.seconds.mean, r.seconds.stddev, r.seconds.min, gflops(r), gbytes(r),
+                        i+1<records.size() ? "," : "");
+        }
+        std::printf("]\n");
+    }
+    else{
+        std::printf("generator,storage,operation,rows,cols,nnz,bandwidth,profile,reps,median_s,mean_s,stddev_s,min_s,gflops,gbytes_per_s\n");
+        for(const Record &r: records)
+            std::printf("%s,%s,%s,%zu,%zu,%zu,%zu,%zu,%d,%.9g,%.9g,%.9g,%.9g,%.6g,%.6g\n",
+                        r.generator.c_str(), r.storage.c_str(), r.operation.c_str(), r.rows, r.cols, r.nnz, r.bandwidth, r.profile, r.reps,
+                        r.seconds.median, r.seconds.mean, r.seconds.stddev, r.seconds.min, gflops(r), gbytes(r));
+    }
+}
+
+/**
+ * \brief Writes the triplets in MatrixMarket coordinate format, 1-based, as read by readMatrixMarket
+ */
+bool writeMatrixMarket(const TripletMatrix<double> &m, const std::string &filename){
+    std::FILE *file= std::fopen(filename.c_str(), "w");
+    if(!file)
+        return false;
+    std::fprintf(file, "%%%%MatrixMarket matrix coordinate real general\n%zu %zu %zu\n", m.rows, m.cols, m.triplets.size());
+    for(const auto &t: m.triplets)
+        std::fprintf(file, "%zu %zu %.17g\n", t.row+1, t.col+1, t.value);
+    return std::fclose(file)==0;
+}
+
+/**
+ * \brief Times the insertions of the elements one by one with the call operator, in random order, into an uncompressed
+ *        matrix with assembly backend A, then compress() and the destruction of the matrix, with the memory of the
+ *        assembly state taken from the default resource or from an AssemblyArena (released after the destruction)
+ */
+template <StorageOrder s, template<class,StorageOrder,class> class A, class Add>
+void runAssembly(const Options &options, const std::string &name, std::span<const Triplet<double>> shuffled,
+                 std::size_t rows, std::size_t cols, bool use_arena, Add add){
+    using Matrix= SparseMatrix<double,s,std::size_t,A>;
+    AssemblyArena arena;
+    std::pmr::memory_resource *resource= use_arena ? &arena : std::pmr::get_default_resource();
+    std::optional<Matrix> a;
+    auto assemble= [&]{
+        a.emplace(rows, cols, resource);
+        for(const auto &t: shuffled)
+            (*a)(t.row, t.col)+= t.value;
+    };
+    auto teardown= [&]{
+        a.reset();
+        if(use_arena)
+            arena.release();
+    };
+    add("assembly_"+name, measure(options, teardown, [&]{ assemble(); sink= a->rows(); }), 0, shuffled.size_bytes());
+    add("compress_teardown_"+name, measure(options, [&]{ teardown(); assemble(); }, [&]{ a->compress(); sink= a->values()[0]; teardown(); }),
+        0, shuffled.size_bytes());
+    teardown();
+}
+
+/**
+ * \brief Runs every case on one matrix in storage order s and appends the records
+ */
+template <StorageOrder s>
+void runCases(const Options &options, const std::string &generator, const TripletMatrix<double> &triplets,
+              const std::string &mtx_file, std::vector<Record> &records){
+
+    using Matrix= SparseMatrix<double,s>;
+    using Index= std::size_t;
+    const std::string storage= IsRowWise<s>::value ? "row_wise" : "column_wise";
+    std::span<const Triplet<double>> entries(triplets.triplets);
+
+    Matrix m(triplets.rows, triplets.cols);
+    m.setFromTriplets(entries);
+    const std::size_t rows= m.rows(), cols= m.cols(), nnz= m.values().size();
+    if(nnz==0){
+        std::fprintf(stderr, "  %-12s no non-zero elements, skipped\n", storage.c_str());
+        return;
+    }
+    const double compressed_bytes= nnz*(sizeof(double)+sizeof(Index)) + m.inner().size()*sizeof(Index);
+    const double vector_bytes= (rows+cols)*sizeof(double);
+
+    const std::size_t band= bandwidth(m), envelope= profile(m);
+
+    auto addFor= [&](const std::string &operation, Stats seconds, double flops, double bytes, std::size_t b, std::size_t p){
+        records.push_back({generator, storage, operation, rows, cols, nnz, b, p, options.reps, seconds, flops, bytes});
+        std::fprintf(stderr, "  %-12s %-28s %10.3f ms\n", storage.c_str(), operation.c_str(), seconds.median*1e3);
+    };
+    auto add= [&](const std::string &operation, Stats seconds, double flops, double bytes){
+        addFor(operation, seconds, flops, bytes, band, envelope);
+    };
+
+    std::mt19937_64 gen(7);
+    std::vector<double> x(cols), y(rows);
+    for(auto &v: x)
+        v= std::uniform_real_distribution<double>(-1., 1.)(gen);
+
+    //assembly and change of state
+    add("setFromTriplets", measure(options, [&]{ Matrix a(rows, cols); a.setFromTriplets(entries); sink= a.values()[0]; }),
+        0, entries.size_bytes() + compressed_bytes);
+
+    if(nnz<=options.uncompressed_limit){
+        add("uncompress", measure(options, [&]{ m.compress(); }, [&]{ m.uncompress(); }), 0, compressed_bytes);
+        add("compress", measure(options, [&]{ m.uncompress(); }, [&]{ m.compress(); }), 0, compressed_bytes);
+
+        m.uncompress();
+        add("product_uncompressed", measure(options, [&]{ y= m*x; sink= y[0]; }), 2.*nnz, compressed_bytes + vector_bytes);
+        m.compress();
+
+        if(!mtx_file.empty()){
+            double file_bytes= std::filesystem::file_size(mtx_file);
+            add("readMatrixMarket", measure(options, [&]{ Matrix a= readMatrixMarket<double,s>(mtx_file); sink= a.rows(); }),
+                0, file_bytes);
+            add("readMatrixMarketMapped", measure(options, [&]{ Matrix a= readMatrixMarketMapped<double,s>(mtx_file); sink= a.rows(); }),
+                0, file_bytes);
+        }
+    }
+    else
+        m.compress();
+
+    //insertions in random order with the call operator, the memory of the assembly state from the default resource
+    //or from an AssemblyArena
+    if(nnz<=options.uncompressed_limit){
+        std::vector<Triplet<double>> shuffled(entries.begin(), entries.end());
+        std::shuffle(shuffled.begin(), shuffled.end(), gen);
+        std::span<const Triplet<double>> insertions(shuffled);
+        runAssembly<s,MapAssembly>(options, "map", insertions, rows, cols, false, add);
+        runAssembly<s,MapAssembly>(options, "map_arena", insertions, rows, cols, true, add);
+        runAssembly<s,HashAssembly>(options, "hash", insertions, rows, cols, false, add);
+        runAssembly<s,HashAssembly>(options, "hash_arena", insertions, rows, cols, true, add);
+    }
+
+    //element access, one million positions of stored elements
+    std::vector<std::pair<std::size_t,std::size_t>> positions(std::min<std::size_t>(entries.size(), 1'000'000));
+    std::uniform_int_distribution<std::size_t> pick(0, entries.size()-1);
+    for(auto &p: positions){
+        const auto &t= entries[pick(gen)];
+        p= {t.row, t.col};
+    }
+    const Matrix &cm= m;
+    add("access_random", measure(options, [&]{
+            double sum=0;
+            for(const auto &[i,j]: positions)
+                sum+= cm(i,j);
+            sink= sum;
+        }), 0, positions.size()*(sizeof(double)+sizeof(Index)));
+    SparseMatrixView<double,s> view= m;
+    add("access_cursor", measure(options, [&]{
+            SparseMatrixCursor cursor(view);
+            std::size_t n_inner= view.inner().size()-1;
+            double sum=0;
+            for(std::size_t k=0; k<n_inner; ++k)
+                for(std::size_t j=view.inner()[k]; j<view.inner()[k+1]; ++j)
+                    sum+= IsRowWise<s>::value ? cursor(k, view.outer()[j]) : cursor(view.outer()[j], k);
+            sink= sum;
+        }), 0, compressed_bytes);
+
+    //products
+    const double flops= 2.*nnz;
+    add("product", measure(options, [&]{ y= m*x; sink= y[0]; }), flops, compressed_bytes + vector_bytes);
+    add("parallelProduct", measure(options, [&]{ y= parallelProduct(m, x, options.threads); sink= y[0]; }),
+        flops, compressed_bytes + vector_bytes);
+    add("gemv_view_beta", measure(options, [&]{ gemv(2., view, x, 0.5, y); sink= y[0]; }),
+        flops + 3.*rows, compressed_bytes + vector_bytes + rows*sizeof(double));
+    std::vector<double> xt(rows, 1.), yt(cols);
+    add("transposeProduct", measure(options, [&]{ yt= transposeProduct(m, xt); sink= yt[0]; }), flops, compressed_bytes + vector_bytes);
+    const std::size_t k= 8;
+    std::vector<double> X(cols*k, 1.);
+    //shape chosen at compile time, and dot product with a matrix of one column (the rows of the matrix summed)
+    if(rows==cols)
+        add("product_square", measure(options, [&]{ y= product<SquareShape>(m, x); sink= y[0]; }), flops, compressed_bytes + vector_bytes);
+    std::vector<double> row_sums(rows);
+    for(const auto &t: entries)
+        row_sums[t.row]+= t.value;
+    std::vector<Triplet<double>> column_entries;
+    for(std::size_t i=0; i<rows; ++i)
+        if(row_sums[i]!=0.)
+            column_entries.push_back({i, 0, row_sums[i]});
+    SparseMatrix<double,s> column(rows, 1);
+    column.setFromTriplets(std::span<const Triplet<double>>(column_entries));
+    const std::size_t column_nnz= column.values().size();
+    std::vector<double> xr(rows, 1.);
+    add("dot_column", measure(options, [&]{ sink= dot(column, xr); }), 2.*column_nnz,
+        column_nnz*(sizeof(double)+sizeof(Index)) + column.inner().size()*sizeof(Index) + rows*sizeof(double));
+    add("multiply_k8", measure(options, [&]{ auto Y= multiply(m, X, k, row_wise); sink= Y[0]; }),
+        flops*k, compressed_bytes + k*vector_bytes);
+
+    //block format with 3x3 blocks, the zeros filling the blocks are multiplied as well; the blocks are counted first (by
+    //block rows, or block columns, with a marker) and the format is skipped if it stores more than 4 values per element,
+    //as for scattered matrices, where it would take up to 9 times the memory of the values
+    const std::size_t n_major= m.inner().size()-1;
+    std::vector<std::size_t> marker(((IsRowWise<s>::value ? cols : rows)+2)/3, std::size_t(-1));
+    std::size_t n_blocks= 0;
+    for(std::size_t b=0; 3*b<n_major; ++b)
+        for(std::size_t j=m.inner()[3*b]; j<m.inner()[std::min(3*b+3, n_major)]; ++j)
+            if(marker[m.outer()[j]/3]!=b){
+                marker[m.outer()[j]/3]= b;
+                ++n_blocks;
+            }
+    std::fprintf(stderr, "  %-12s bsr3x3: fill ratio %.3f\n", storage.c_str(), 9.*n_blocks/nnz);
+    if(9*n_blocks<=4*nnz){
+        add("toBlockSparse3x3", measure(options, [&]{ BlockSparseMatrix<double,3> b(m); sink= b.blocks(); }), 0, 2*compressed_bytes);
+        const BlockSparseMatrix<double,3> bsr(m);
+        const double bsr_bytes= bsr.blocks()*(9*sizeof(double)+sizeof(Index)) + ((rows+2)/3+1)*sizeof(Index);
+        add("product_bsr3x3", measure(options, [&]{ y= bsr*x; sink= y[0]; }), 18.*bsr.blocks(), bsr_bytes + vector_bytes);
+    }
+
+    //SELL-8-sigma with the default windows and with all the rows sorted, the padding is multiplied as well
+    for(std::size_t sigma: {std::size_t(256), rows}){
+        const SellMatrix<double,8> sell(m, sigma);
+        const std::string name= sigma==rows ? "product_sell8_sorted" : "product_sell8";
+        std::fprintf(stderr, "  %-12s sell8 sigma %zu: padding overhead %.3f\n", storage.c_str(), sigma, sell.paddingOverhead());
+        add(name, measure(options, [&]{ y= sell*x; sink= y[0]; }), 2.*sell.storedElements(),
+            sell.storedElements()*(sizeof(double)+sizeof(Index)) + ((rows+7)/8+1+2*rows)*sizeof(Index) + vector_bytes);
+    }
+
+    //mixed precision, values stored in float and bfloat16, accumulated in double
+    const auto mf= castValues<float>(m);
+    const auto mb= castValues<bfloat16>(m);
+    const double float_bytes= nnz*(sizeof(float)+sizeof(Index)) + m.inner().size()*sizeof(Index);
+    const double bfloat16_bytes= nnz*(sizeof(bfloat16)+sizeof(Index)) + m.inner().size()*sizeof(Index);
+    add("product_float", measure(options, [&]{ y= mf*x; sink= y[0]; }), flops, float_bytes + vector_bytes);
+    add("parallelProduct_float", measure(options, [&]{ y= parallelProduct(mf, x, options.threads); sink= y[0]; }),
+        flops, float_bytes + vector_bytes);
+    add("product_bfloat16", measure(options, [&]{ y= mb*x; sink= y[0]; }), flops, bfloat16_bytes + vector_bytes);
+    add("parallelProduct_bfloat16", measure(options, [&]{ y= parallelProduct(mb, x, options.threads); sink= y[0]; }),
+        flops, bfloat16_bytes + vector_bytes);
+
+    //the cases below need a square matrix
+    if(rows!=cols)
+        return;
+
+    //symmetric matrices, product with the stored upper triangle
+    const SymmetricSparseMatrix<double,s,Index> sym(m);
+    const auto expanded= sym.template toSparseMatrix<s>();
+    if(std::ranges::equal(expanded.inner(), m.inner()) && std::ranges::equal(expanded.outer(), m.outer())
+       && std::ranges::equal(expanded.values(), m.values())){
+        const auto &triangle= sym.triangle();
+        const double triangle_bytes= triangle.values().size()*(sizeof(double)+sizeof(Index)) + triangle.inner().size()*sizeof(Index);
+        add("symmetricProduct", measure(options, [&]{ y= sym*x; sink= y[0]; }), flops, triangle_bytes + vector_bytes);
+        add("parallelSymmetricProduct", measure(options, [&]{ y= parallelProduct(sym, x, options.threads); sink= y[0]; }),
+            flops, triangle_bytes + vector_bytes);
+    }
+
+    //sparse product A*A, with A in the same storage order and in the other one; every element a(i,k) is multiplied by
+    //the row k of A
+    std::vector<std::size_t> row_len(rows), col_len(cols);
+    for(std::size_t k=0; k+1<m.inner().size(); ++k)
+        for(std::size_t j=m.inner()[k]; j<m.inner()[k+1]; ++j){
+            ++row_len[IsRowWise<s>::value ? k : m.outer()[j]];
+            ++col_len[IsRowWise<s>::value ? m.outer()[j] : k];
+        }
+    double product_flops= 0;
+    for(std::size_t k=0; k<rows; ++k)
+        product_flops+= 2.*col_len[k]*row_len[k];
+    //the result can have as many elements as multiplications
+    if(product_flops/2<=options.product_limit){
+        const auto other= changeStorageOrder(m);
+        std::size_t product_nnz= sparseProduct(m, m, options.threads).values().size();
+        const double product_bytes= 2*compressed_bytes + product_nnz*(sizeof(double)+sizeof(Index)) + m.inner().size()*sizeof(Index);
+        add("sparseProduct", measure(options, [&]{ auto c= sparseProduct(m, m, options.threads); sink= c.values().size(); }),
+            product_flops, product_bytes);
+        add("sparseProduct_mixed", measure(options, [&]{ auto c= sparseProduct(m, other, options.threads); sink= c.values().size(); }),
+            product_flops, product_bytes + compressed_bytes);
+    }
+
+    //reorderings, the products run on the permuted matrix and vector
+    add("reorder_rcm", measure(options, [&]{ auto r= reorder(m); sink= r.permutation[0]; }), 0, 2*compressed_bytes);
+    const auto reordered= reorder(m);
+    const Matrix &rcm= reordered.matrix;
+    std::vector<double> px= permuteVector(x, reordered.permutation);
+    std::size_t rcm_band= bandwidth(rcm), rcm_envelope= profile(rcm);
+    std::fprintf(stderr, "  %-12s rcm: bandwidth %zu -> %zu, profile %zu -> %zu\n", storage.c_str(), band, rcm_band, envelope, rcm_envelope);
+    addFor("product_rcm", measure(options, [&]{ y= rcm*px; sink= y[0]; }), flops, compressed_bytes + vector_bytes, rcm_band, rcm_envelope);
+    addFor("parallelProduct_rcm", measure(options, [&]{ y= parallelProduct(rcm, px, options.threads); sink= y[0]; }),
+           flops, compressed_bytes + vector_bytes, rcm_band, rcm_envelope);
+
+    add("reorder_bisection", measure(options, [&]{ auto r= reorder(m, Ordering::bisection, options.threads); sink= r.permutation[0]; }),
+        0, 2*compressed_bytes);
+    const auto bisected= reorder(m, Ordering::bisection, options.threads);
+    const Matrix &parts= bisected.matrix;
+    px= permuteVector(x, bisected.permutation);
+    addFor("parallelProduct_bisection", measure(options, [&]{ y= parallelProduct(parts, px, options.threads); sink= y[0]; }),
+           flops, compressed_bytes + vector_bytes, bandwidth(parts), profile(parts));
+}
+
+/**
+ * \brief Reads a MatrixMarket file as triplets
+ */
+TripletMatrix<double> readTriplets(const std::string &filename){
+    SparseMatrix<double,row_wise> m= readMatrixMarketMapped<double,row_wise>(filename);
+    TripletMatrix<double> triplets{m.rows(), m.cols(), {}};
+    triplets.triplets.reserve(m.values().size());
+    for(std::size_t i=0; i+1<m.inner().size(); ++i)
+        for(std::size_t j=m.inner()[i]; j<m.inner()[i+1]; ++j)
+            triplets.triplets.push_back({i, m.outer()[j], m.values()[j]});
+    return triplets;
+}
+
+}
+
+int main(int argc, char **argv){
+
+    Options options;
+    for(int a=1; a<argc; ++a){
+        std::string arg= argv[a];
+        auto value= [&](const char *name) -> const char *{
+            std::string prefix= std::string("--")+name+"=";
+            return arg.rfind(prefix, 0)==0 ? argv[a]+prefix.size() : nullptr;
+        };
+        if(const char *v= value("nnz"))                     options.nnz= std::strtoull(v, nullptr, 10);
+        else if(const char *v= value("per-row"))            options.per_row= std::max<std::size_t>(1, std::strtoull(v, nullptr, 10));
+        else if(const char *v= value("warmup"))             options.warmup= std::atoi(v);
+        else if(const char *v= value("reps"))               options.reps= std::max(1, std::atoi(v));
+        else if(const char *v= value("threads"))            options.threads= std::strtoull(v, nullptr, 10);
+        else if(const char *v= value("format"))             options.json= (std::string(v)=="json");
+        else if(const char *v= value("generators"))         options.generators= v;
+        else if(const char *v= value("uncompressed-limit")) options.uncompressed_limit= std::strtoull(v, nullptr, 10);
+        else if(const char *v= value("product-limit"))      options.product_limit= std::strtoull(v, nullptr, 10);
+        else if(const char *v= value("mtx"))                options.mtx_files= v;
+        else{
+            std::fprintf(stderr, "usage: %s [--nnz=N] [--per-row=N] [--warmup=N] [--reps=N] [--threads=N] [--format=csv|json]\n"
+                                 "       [--generators=banded,random,powerlaw,fem,fem_shuffled] [--uncompressed-limit=N] [--product-limit=N] [--mtx=file[,file]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    auto selected= [&](const std::string &name){ return ("," + options.generators + ",").find("," + name + ",")!=std::string::npos; };
+    const std::size_t n= std::max<std::size_t>(1, options.nnz/options.per_row);
+    const std::size_t side= std::max<std::size_t>(2, std::llround(std::cbrt(options.nnz/27.)));
+
+    std::vector<Record> records;
+    auto run= [&](const std::string &name, auto make, bool always=false){
+        if(!always && !selected(name))
+            return;
+        std::fprintf(stderr, "%s\n", name.c_str());
+        TripletMatrix<double> triplets= make();
+        std::string mtx_file;
+        if(triplets.triplets.size()<=options.uncompressed_limit){
+            mtx_file= (std::filesystem::temp_directory_path() / ("benchmark_" + name + ".mtx")).string();
+            if(!writeMatrixMarket(triplets, mtx_file))
+                mtx_file.clear();
+        }
+        runCases<row_wise>(options, name, triplets, mtx_file, records);
+        runCases<column_wise>(options, name, triplets, mtx_file, records);
+        if(!mtx_file.empty())
+            std::filesystem::remove(mtx_file);
+    };
+
+    run("banded", [&]{ std::size_t h= options.per_row/2; return bandedMatrix<double>(std::max<std::size_t>(1, options.nnz/(2*h+1)), h); });
+    run("random", [&]{ return randomUniformMatrix<double>(n, options.per_row); });
+    run("powerlaw", [&]{ return powerLawMatrix<double>(n, double(options.per_row)); });
+    run("fem", [&]{ return femStencilMatrix<double>(side, side, side); });
+    run("fem_shuffled", [&]{ auto m= femStencilMatrix<double>(side, side, side); shuffleNumbering(m); return m; });
+    for(std::size_t first=0; first<options.mtx_files.size();){
+        std::size_t last= std::min(options.mtx_files.find(',', first), options.mtx_files.size());
+        std::string file= options.mtx_files.substr(first, last-first);
+        run(std::filesystem::path(file).stem().string(), [&]{ return readTriplets(file); }, true);
+        first= last+1;
+    }
+
+    printRecords(records, options.json);
+    return 0;
+}
@@ -0,0 +1,98 @@
+#ifndef ASSEMBLYARENA_HPP
+#define ASSEMBLYARENA_HPP
+
+/**
+ * \file AssemblyArena.hpp
+ * \brief Monotonic memory resource for the assembly state of sparse matrices
+ */
+
+// clang-format off
+#include <cstddef>
+#include <iostream>
+#include <memory_resource>
+
+namespace algebra{
+
+/**
+ * \brief Monotonic arena for build-then-compress workflows
+ *
+ * Memory is handed out from chunks of growing size taken from the upstream resource: an allocation is a pointer
+ * bump and a deallocation does nothing, so that the one-node-per-element containers of the uncompressed state
+ * neither call malloc nor fragment the heap. compress() empties the assembly containers, then release() gives
+ * all the chunks back to the upstream resource in one step:
+ *
+ *     AssemblyArena arena;
+ *     SparseMatrix<double,row_wise> m(n, n, &arena);
+ *     //... m(i,j)+= ...
+ *     m.compress();
+ *     arena.release();
+ *
+ * The arena counts the allocations not deallocated yet, so that it is not released under a live container.
+ * \note Not thread-safe: one arena per thread that assembles. The object can be neither copied nor moved
+ */
+class AssemblyArena : public std::pmr::memory_resource{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param initial_size Size in bytes of the first chunk, the next ones grow geometrically
+     * \param upstream Resource of the chunks
+     */
+    explicit AssemblyArena(std::size_t initial_size= 1<<16, std::pmr::memory_resource *upstream= std::pmr::get_default_resource()):
+        m_arena(initial_size, upstream) {};
+
+    AssemblyArena(const AssemblyArena &)= delete;
+    AssemblyArena & operator=(const AssemblyArena &)= delete;
+
+    /**
+     * \brief Gives all the chunks back to the upstream resource
+     * \return true if the arena was released, false (and an error is printed) if some allocations are still live
+     */
+    bool release(){
+        if(m_live){
+            std::cerr << "AssemblyArena released with " << m_live << " live allocations\n";
+            return false;
+        }
+        m_arena.release();
+        m_bytes= 0;
+        return true;
+    };
+
+    /**
+     * \brief Number of allocations not deallocated yet
+     */
+    std::size_t liveAllocations() const {return m_live;};
+
+    /**
+     * \brief Bytes handed out since the construction or the last release
+     */
+    std::size_t bytesAllocated() const {return m_bytes;};
+
+private:
+
+    std::pmr::monotonic_buffer_resource m_arena;
+    std::size_t m_live=0, m_bytes=0;
+
+    void * do_allocate(std::size_t bytes, std::size_t alignment) override{
+        void *p= m_arena.allocate(bytes, alignment);
+        ++m_live;
+        m_bytes+= bytes;
+        return p;
+    };
+
+    //the memory is reused only after release()
+    void do_deallocate(void *, std::size_t, std::size_t) override{
+        --m_live;
+    };
+
+    bool do_is_equal(const std::pmr::memory_resource &other) const noexcept override{
+        return this==&other;
+    };
+
+};
+
+};
+
+
+#endif /*ASSEMBLYARENA_HPP*/
@@ -0,0 +1,554 @@
+#ifndef ASSEMBLYBACKENDS_HPP
+#define ASSEMBLYBACKENDS_HPP
+
+/**
+ * \file AssemblyBackends.hpp
+ * \brief Containers of the uncompressed state (and of the pending insertions) of a SparseMatrix
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <map>
+#include <memory_resource>
+#include <utility>
+#include <vector>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Sequence of elements stored in blocks of doubling size that are never moved, so that references stay valid
+ *
+ * Every block is allocated with its full capacity, also in the copies, since a copied std::vector would have only
+ * the capacity of its elements and the next emplace_back into the last block would move them.
+ *
+ * \tparam V Type of the elements
+ */
+template <class V>
+class StableBlocks{
+
+public:
+
+    /**
+     * \brief Constructor
+     * \param resource Memory resource of the blocks
+     */
+    explicit StableBlocks(std::pmr::memory_resource *resource): m_blocks(resource) {};
+
+    /**
+     * \brief Copy constructor, every block of the copy gets its full capacity, so that it is never reallocated
+     * \param other The copied sequence
+     * \param resource Memory resource of the blocks, the default one as for the std::pmr containers
+     */
+    StableBlocks(const StableBlocks &other, std::pmr::memory_resource *resource= std::pmr::get_default_resource()):
+        m_blocks(resource), m_size(other.m_size){
+        m_blocks.reserve(other.m_blocks.size());
+        for(const auto &block: other.m_blocks){
+            auto &copy= m_blocks.emplace_back();
+            copy.reserve(first_block<<(m_blocks.size()-1));
+            for(const auto &element: block)
+                copy.emplace_back(element);
+        }
+    };
+
+    StableBlocks(StableBlocks &&other) = default;
+
+    /**
+     * \brief Copy assignment, the blocks keep the memory resource of this sequence
+     */
+    StableBlocks & operator=(const StableBlocks &other){
+        if(this!=&other){
+            StableBlocks copy(other, resource());
+            swap(copy);
+        }
+        return *this;
+    };
+
+    /**
+     * \brief Move assignment, the blocks are taken over if the two memory resources are equal, otherwise they are copied
+     *        into blocks of this sequence's resource (moving them would leave the copies without their full capacity)
+     */
+    StableBlocks & operator=(StableBlocks &&other){
+        if(this==&other)
+            return *this;
+        if(resource()->is_equal(*other.resource())){
+            m_blocks.swap(other.m_blocks); //a move assignment of the vector would need assignable elements
+            m_size= std::exchange(other.m_size, 0);
+            other.m_blocks.clear();
+        }
+        else
+            *this= std::as_const(other);
+        return *this;
+    };
+
+    /**
+     * \brief Appends an element, opening a new block when the last one is full
+     * \return Reference to the new element
+     */
+    template <class... Args>
+    V & emplace_back(Args&&... args){
+        if(m_blocks.empty() || m_blocks.back().size()==(first_block<<(m_blocks.size()-1))){
+            m_blocks.emplace_back();
+            m_blocks.back().reserve(first_block<<(m_blocks.size()-1));
+        }
+        ++m_size;
+        return m_blocks.back().emplace_back(std::forward<Args>(args)...);
+    };
+
+    /**
+     * \brief Element at position i
+     */
+    const V & operator[](std::size_t i) const{
+        std::size_t j= i+first_block;
+        std::size_t k= std::bit_width(j)-std::bit_width(first_block);
+        return m_blocks[k][j-(first_block<<k)];
+    };
+
+    V & operator[](std::size_t i){
+        return const_cast<V&>(std::as_const(*this)[i]);
+    };
+
+    const V & back() const {return m_blocks.back().back();};
+
+    std::size_t size() const {return m_size;};
+
+    bool empty() const {return m_size==0;};
+
+    /**
+     * \brief Removes all the elements and frees the blocks
+     */
+    void clear(){
+        decltype(m_blocks)(m_blocks.get_allocator()).swap(m_blocks);
+        m_size= 0;
+    };
+
+    /**
+     * \brief Calls f(element) for every element, in order
+     */
+    template <class F>
+    void forEach(F f) const{
+        for(const auto &block: m_blocks)
+            for(const auto &element: block)
+                f(element);
+    };
+
+    std::pmr::memory_resource * resource() const {return m_blocks.get_allocator().resource();};
+
+    void swap(StableBlocks &other){
+        m_blocks.swap(other.m_blocks);
+        std::swap(m_size, other.m_size);
+    };
+
+private:
+
+    /**
+     * \brief Size of the first block, block k holds first_block<<k elements
+     */
+    static constexpr std::size_t first_block= 16;
+
+    std::pmr::vector<std::pmr::vector<V>> m_blocks;
+    std::size_t m_size=0;
+
+};
+
+/**
+ * \brief Run of elements inserted in strictly increasing lessOperator order, the fast path of the assembly backends
+ *
+ * While the keys arrive sorted (e.g. a coordinate file read row by row into a row-wise matrix) a backend appends
+ * them here in O(1), without touching its tree or hash table, and sorted() needs no sorting; a key that breaks
+ * the order goes to the general container, and the run stays as it is.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order, it gives the order of the run
+ * \tparam Index Type of the row and column indexes
+ */
+template <class T, StorageOrder storage, class Index>
+class SortedRun{
+
+public:
+
+    using key_type= std::array<Index,2>;
+    using value_type= std::pair<const key_type, T>;
+
+    explicit SortedRun(std::pmr::memory_resource *resource): m_elements(resource) {};
+
+    /**
+     * \brief Check if key follows all the elements of the run
+     */
+    bool accepts(const key_type &key) const{
+        return m_elements.empty() || lessOperator<storage, Index>()(m_elements.back().first, key);
+    };
+
+    /**
+     * \brief Appends key with value T(), key must be accepted
+     */
+    T & append(const key_type &key){
+        return m_elements.emplace_back(key, T()).second;
+    };
+
+    /**
+     * \brief Pointer to the value of a key, nullptr if the key is not in the run; binary search
+     */
+    const T * find(const key_type &key) const{
+        lessOperator<storage, Index> less;
+        std::size_t first= 0, count= m_elements.size();
+        while(count>0){
+            std::size_t half= count/2;
+            if(less(m_elements[first+half].first, key)){
+                first+= half+1;
+                count-= half+1;
+            }
+            else
+                count= half;
+        }
+        return first<m_elements.size() && m_elements[first].first==key ? &m_elements[first].second : nullptr;
+    };
+
+    T * find(const key_type &key){
+        return const_cast<T*>(std::as_const(*this).find(key));
+    };
+
+    std::size_t size() const {return m_elements.size();};
+
+    bool empty() const {return m_elements.empty();};
+
+    void clear(){ m_elements.clear(); };
+
+    /**
+     * \brief Calls f(key, value) for every element, in lessOperator order
+     */
+    template <class F>
+    void forEach(F f) const{
+        m_elements.forEach([&f](const value_type &element){ f(element.first, element.second); });
+    };
+
+    /**
+     * \brief Removes the elements whose key satisfies pred, the others stay sorted
+     */
+    template <class Pred>
+    void eraseIf(Pred pred){
+        StableBlocks<value_type> kept(m_elements.resource());
+        m_elements.forEach([&](const value_type &element){
+            if(!pred(element.first))
+                kept.emplace_back(element);
+        });
+        m_elements.swap(kept);
+    };
+
+    /**
+     * \brief Merges the run with the sorted elements of the general container
+     * \param others Pointers to the other elements, in lessOperator order
+     * \return Pointers to all the elements in lessOperator order
+     */
+    std::vector<const value_type*> merge(const std::vector<const value_type*> &others) const{
+        std::vector<const value_type*> run;
+        run.reserve(m_elements.size());
+        m_elements.forEach([&run](const value_type &element){ run.push_back(&element); });
+        if(others.empty())
+            return run;
+        std::vector<const value_type*> res(run.size()+others.size());
+        lessOperator<storage, Index> less;
+        std::merge(run.begin(), run.end(), others.begin(), others.end(), res.begin(),
+                   [&less](const value_type *a, const value_type *b){ return less(a->first, b->first); });
+        return res;
+    };
+
+private:
+
+    StableBlocks<value_type> m_elements;
+
+};
+
+};
+
+/**
+ * \brief Assembly backend on an ordered std::map, one node per element, the default one
+ *
+ * Every backend maps a key {row, column} to a value and offers the same interface: a constructor from a
+ * std::pmr::memory_resource, used for all its memory, find, operator[], size, empty, clear (which gives all the
+ * memory back), forEach (iteration in any order), eraseIf and sorted (the elements in lessOperator order).
+ * References returned by operator[] stay valid until the element is erased.
+ * Both backends append the keys that arrive in increasing lessOperator order to a detail::SortedRun, as long
+ * as the general container is empty: assembling in the storage order costs O(1) per element and no tree.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order, it gives the order of sorted()
+ * \tparam Index Type of the row and column indexes
+ */
+template <class T, StorageOrder storage, class Index>
+class MapAssembly{
+
+public:
+
+    using key_type= std::array<Index,2>;
+    using value_type= std::pair<const key_type, T>;
+
+    /**
+     * \brief Constructor
+     * \param resource Memory resource of the nodes of the map and of the sorted run
+     */
+    explicit MapAssembly(std::pmr::memory_resource *resource= std::pmr::get_default_resource()):
+        m_run(resource), m_map(resource) {};
+
+    /**
+     * \brief Pointer to the value of a key, nullptr if the key is not stored
+     */
+    T * find(const key_type &key){
+        return const_cast<T*>(std::as_const(*this).find(key));
+    };
+
+    /**
+     * \brief Pointer to the value of a key, nullptr if the key is not stored
+     */
+    const T * find(const key_type &key) const{
+        if(const T *value= m_run.find(key))
+            return value;
+        auto it= m_map.find(key);
+        return it!=m_map.end() ? &it->second : nullptr;
+    };
+
+    /**
+     * \brief Reference to the value of a key, inserted with value T() if it is not stored
+     */
+    T & operator[](const key_type &key){
+        if(m_map.empty() && m_run.accepts(key))
+            return m_run.append(key);
+        if(T *value= m_run.find(key))
+            return *value;
+        return m_map[key];
+    };
+
+    /**
+     * \brief Number of stored elements
+     */
+    std::size_t size() const {return m_run.size()+m_map.size();};
+
+    /**
+     * \brief Check if there are no elements
+     */
+    bool empty() const {return m_run.empty() && m_map.empty();};
+
+    /**
+     * \brief Removes all the elements
+     */
+    void clear(){
+        m_run.clear();
+        m_map.clear();
+    };
+
+    /**
+     * \brief Calls f(key, value) for every element
+     */
+    template <class F>
+    void forEach(F f) const{
+        m_run.forEach(f);
+        for(const auto &[key, value]: m_map)
+            f(key, value);
+    };
+
+    /**
+     * \brief Removes the elements whose key satisfies pred
+     * \tparam Pred Type of the predicate, called as pred(key)
+     * \param pred The predicate
+     */
+    template <class Pred>
+    void eraseIf(Pred pred){
+        m_run.eraseIf(pred);
+        std::erase_if(m_map, [&pred](const auto &element){ return pred(element.first); });
+    };
+
+    /**
+     * \brief Pointers to the elements in lessOperator order
+     */
+    std::vector<const value_type*> sorted() const{
+        std::vector<const value_type*> res;
+        res.reserve(m_map.size());
+        for(const auto &element: m_map)
+            res.push_back(&element);
+        return m_run.merge(res);
+    };
+
+private:
+
+    detail::SortedRun<T, storage, Index> m_run;
+    std::pmr::map<key_type, T, lessOperator<storage, Index>> m_map;
+
+};
+
+/**
+ * \brief Assembly backend on a flat hash table with open addressing (linear probing)
+ *
+ * The elements are stored one after the other, in insertion order, in blocks of doubling size that are never
+ * moved, so that references returned by operator[] stay valid while new elements are inserted; the table holds
+ * only their positions. Lookups and insertions touch one or two cache lines instead of a path of tree nodes, and
+ * iterations (e.g. in the product) run over contiguous blocks. The lessOperator order is built only when sorted()
+ * is called, e.g. by compress(). eraseIf rebuilds the containers and invalidates the references.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order, it gives the order of sorted()
+ * \tparam Index Type of the row and column indexes
+ */
+template <class T, StorageOrder storage, class Index>
+class HashAssembly{
+
+public:
+
+    using key_type= std::array<Index,2>;
+    using value_type= std::pair<const key_type, T>;
+
+    /**
+     * \brief Constructor
+     * \param resource Memory resource of the table, of the blocks of elements and of the sorted run
+     */
+    explicit HashAssembly(std::pmr::memory_resource *resource= std::pmr::get_default_resource()):
+        m_run(resource), m_slots(resource), m_entries(resource) {};
+
+    /**
+     * \brief Pointer to the value of a key, nullptr if the key is not stored
+     */
+    T * find(const key_type &key){
+        return const_cast<T*>(std::as_const(*this).find(key));
+    };
+
+    /**
+     * \brief Pointer to the value of a key, nullptr if the key is not stored
+     */
+    const T * find(const key_type &key) const{
+        if(const T *value= m_run.find(key))
+            return value;
+        if(m_entries.empty())
+            return nullptr;
+        std::size_t s= slot(key);
+        return m_slots[s] ? &m_entries[m_slots[s]-1].second : nullptr;
+    };
+
+    /**
+     * \brief Reference to the value of a key, inserted with value T() if it is not stored
+     */
+    T & operator[](const key_type &key){
+        if(m_entries.empty() && m_run.accepts(key))
+            return m_run.append(key);
+        if(T *value= m_run.find(key))
+            return *value;
+        //the load factor stays below 0.7
+        if(10*(m_entries.size()+1) > 7*m_slots.size())
+            rehash(std::max<std::size_t>(16, 2*m_slots.size()));
+        std::size_t s= slot(key);
+        if(!m_slots[s]){
+            m_entries.emplace_back(key, T());
+            m_slots[s]= m_entries.size();
+        }
+        return m_entries[m_slots[s]-1].second;
+    };
+
+    /**
+     * \brief Number of stored elements
+     */
+    std::size_t size() const {return m_run.size()+m_entries.size();};
+
+    /**
+     * \brief Check if there are no elements
+     */
+    bool empty() const {return m_run.empty() && m_entries.empty();};
+
+    /**
+     * \brief Removes all the elements and frees the table and the blocks
+     */
+    void clear(){
+        m_run.clear();
+        decltype(m_slots)(m_slots.get_allocator()).swap(m_slots);
+        m_entries.clear();
+    };
+
+    /**
+     * \brief Calls f(key, value) for every element
+     */
+    template <class F>
+    void forEach(F f) const{
+        m_run.forEach(f);
+        m_entries.forEach([&f](const value_type &element){ f(element.first, element.second); });
+    };
+
+    /**
+     * \brief Removes the elements whose key satisfies pred
+     * \tparam Pred Type of the predicate, called as pred(key)
+     * \param pred The predicate
+     */
+    template <class Pred>
+    void eraseIf(Pred pred){
+        m_run.eraseIf(pred);
+        detail::StableBlocks<value_type> kept(m_entries.resource());
+        m_entries.forEach([&](const value_type &element){
+            if(!pred(element.first))
+                kept.emplace_back(element);
+        });
+        m_entries.swap(kept);
+        rehash(m_slots.size());
+    };
+
+    /**
+     * \brief Pointers to the elements in lessOperator order, the ones of the hash table are sorted at every call
+     */
+    std::vector<const value_type*> sorted() const{
+        std::vector<const value_type*> res;
+        res.reserve(m_entries.size());
+        m_entries.forEach([&res](const value_type &element){ res.push_back(&element); });
+        lessOperator<storage, Index> less;
+        std::sort(res.begin(), res.end(), [&less](const value_type *a, const value_type *b){ return less(a->first, b->first); });
+        return m_run.merge(res);
+    };
+
+private:
+
+    detail::SortedRun<T, storage, Index> m_run;
+
+    /**
+     * \brief Position+1 in m_entries of the element of every slot, 0 for an empty slot; the size is a power of 2
+     */
+    std::pmr::vector<std::size_t> m_slots;
+    detail::StableBlocks<value_type> m_entries;
+
+    /**
+     * \brief Mixes the two indexes of a key
+     */
+    static std::size_t hash(const key_type &key){
+        std::uint64_t h= static_cast<std::uint64_t>(key[0])*0x9E3779B97F4A7C15ull + key[1];
+        h^= h>>32;
+        h*= 0xD6E8FEB86659FD93ull;
+        h^= h>>32;
+        return static_cast<std::size_t>(h);
+    };
+
+    /**
+     * \brief Slot of a key: the one holding it, or the empty one where it would be inserted
+     */
+    std::size_t slot(const key_type &key) const{
+        std::size_t mask= m_slots.size()-1;
+        std::size_t s= hash(key) & mask;
+        while(m_slots[s] && m_entries[m_slots[s]-1].first!=key)
+            s= (s+1) & mask;
+        return s;
+    };
+
+    /**
+     * \brief Rebuilds the table with n_slots slots (a power of 2)
+     */
+    void rehash(std::size_t n_slots){
+        if(n_slots==0)
+            return;
+        m_slots.assign(n_slots, 0);
+        for(std::size_t i=0; i<m_entries.size(); ++i)
+            m_slots[slot(m_entries[i].first)]= i+1;
+    };
+
+};
+
+};
+
+
+#endif /*ASSEMBLYBACKENDS_HPP*/
@@ -0,0 +1,322 @@
+#ifndef BLOCKSPARSEMATRIX_HPP
+#define BLOCKSPARSEMATRIX_HPP
+
+/**
+ * \file BlockSparseMatrix.hpp
+ * \brief Header file for the BlockSparseMatrix class (block compressed sparse row format)
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Class to store sparse matrices made of small dense blocks, in BSR (block compressed sparse row) format
+ *
+ * The matrix is divided in blocks of R x C elements. Only the blocks with at least one non-zero element are stored,
+ * with one column index per block and all the R*C values of the block, row by row.
+ * The product with a vector works on whole blocks, with loops of compile-time length.
+ *
+ * \tparam T Type of the stored element
+ * \tparam R Number of rows of a block
+ * \tparam C Number of columns of a block
+ */
+template <class T, std::size_t R, std::size_t C = R>
+class BlockSparseMatrix{
+
+    static_assert(R>0 && C>0, "Blocks must have at least one row and one column");
+
+public:
+
+    /**
+     * \brief Constructor of an empty matrix
+     * \param r Number of rows
+     * \param c Number of columns
+     */
+    BlockSparseMatrix(std::size_t r=0, std::size_t c=0);
+
+    /**
+     * \brief Constructor from a SparseMatrix, the blocks containing at least one element are stored
+     * \tparam s Storage order of the SparseMatrix
+     * \tparam I Index type of the SparseMatrix
+     * \tparam A Assembly backend of the SparseMatrix
+     * \param m The SparseMatrix, if it is uncompressed or has pending insertions a compressed copy is used
+     */
+    template <StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    explicit BlockSparseMatrix(const SparseMatrix<T,s,I,A> &m);
+
+    /**
+     * \brief Conversion to a compressed SparseMatrix
+     * \tparam s Storage order of the result
+     * \return The compressed SparseMatrix, without the zeros used to fill the blocks
+     */
+    template <StorageOrder s>
+    SparseMatrix<T,s> toSparseMatrix() const;
+
+    /**
+     * \brief Constant call operator
+     * \param r The row index
+     * \param c The column index
+     * \return The value at the specified position
+     */
+    T operator()(std::size_t r, std::size_t c) const;
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_cols;};
+
+    /**
+     * \brief Number of stored blocks
+     */
+    std::size_t blocks() const {return m_block_outer.size();};
+
+    /**
+     * \brief Ratio between the stored values and the non-zero elements of the original matrix
+     * \return 1 if no zero had to be stored to fill the blocks, more otherwise
+     */
+    double fillRatio() const {return m_nnz ? double(m_block_values.size())/m_nnz : 1.;};
+
+    /**
+     * \brief Function that executes the product between a BlockSparseMatrix and a vector, with compatible dimensions
+     * \tparam U Type of elements stored inside BlockSparseMatrix and std::vector
+     * \tparam RR Number of rows of a block
+     * \tparam CC Number of columns of a block
+     * \param m The BlockSparseMatrix object
+     * \param v The vector object
+     * \return The product vector of elements of type U
+     */
+    template <class U, std::size_t RR, std::size_t CC>
+    friend std::vector<U> operator*(const BlockSparseMatrix<U,RR,CC> &m, const std::vector<U> &v);
+
+private:
+
+    std::size_t m_rows=0, m_cols=0;
+    //number of non-zero elements of the original matrix
+    std::size_t m_nnz=0;
+
+    /**
+     * \brief Index of the first block of every block row, as m_inner of a CSR SparseMatrix
+     */
+    std::vector<std::size_t> m_block_inner;
+
+    /**
+     * \brief Block column index of every block
+     */
+    std::vector<std::size_t> m_block_outer;
+
+    /**
+     * \brief Values of the blocks, R*C per block, row by row inside the block
+     */
+    std::vector<T> m_block_values;
+
+};
+
+/**
+ * \brief Function that executes the product between a BlockSparseMatrix and a vector, with compatible dimensions
+ * \tparam U Type of elements stored inside BlockSparseMatrix and std::vector
+ * \tparam R Number of rows of a block
+ * \tparam C Number of columns of a block
+ * \param m The BlockSparseMatrix object
+ * \param v The vector object
+ * \return The product vector of elements of type U
+ */
+template <class U, std::size_t R, std::size_t C>
+std::vector<U> operator*(const BlockSparseMatrix<U,R,C> &m, const std::vector<U> &v);
+
+
+template <class T, std::size_t R, std::size_t C>
+BlockSparseMatrix<T,R,C>::BlockSparseMatrix(std::size_t r, std::size_t c): m_rows(r), m_cols(c),
+    m_block_inner((r+R-1)/R + 1, 0) {};
+
+/**
+ * @brief Builds the block format from a SparseMatrix.
+ *
+ * Column-wise matrices are first converted to row-wise ones with changeStorageOrder. Then, for every block row, the block columns touched
+ * by its R rows are collected (a marker vector avoids duplicates) and sorted, and the values are copied in the blocks.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam R The number of rows of a block.
+ * @tparam C The number of columns of a block.
+ * @tparam s The storage order of the SparseMatrix.
+ * @tparam I The index type of the SparseMatrix.
+ * @tparam A The assembly backend of the SparseMatrix.
+ * @param m The SparseMatrix.
+ */
+template <class T, std::size_t R, std::size_t C>
+template <StorageOrder s, class I, template<class,StorageOrder,class> class A>
+BlockSparseMatrix<T,R,C>::BlockSparseMatrix(const SparseMatrix<T,s,I,A> &m): BlockSparseMatrix(m.rows(), m.cols()) {
+
+    if constexpr (!IsRowWise<s>::value){
+        //the block rows need the matrix row by row
+        *this= BlockSparseMatrix(changeStorageOrder(m));
+    }
+    else if(!m.is_compressed() || m.pending()){
+        SparseMatrix<T,s,I,A> copy(m);
+        copy.compress();
+        if(copy.is_compressed() && !copy.pending()) //else too many elements for the index type
+            *this= BlockSparseMatrix(copy);
+    }
+    else{
+        auto inner= m.inner();
+        auto outer= m.outer();
+        auto values= m.values();
+        std::size_t n_block_rows= m_block_inner.size()-1;
+        std::size_t n_block_cols= (m_cols+C-1)/C;
+        m_nnz= values.size();
+
+        //marker[bc] is the position of block column bc in the current block row, or npos
+        constexpr std::size_t npos= std::size_t(-1);
+        std::vector<std::size_t> marker(n_block_cols, npos);
+        std::vector<std::size_t> touched;
+
+        for(std::size_t br=0; br<n_block_rows; ++br){
+            std::size_t first_row= br*R, last_row= std::min(first_row+R, m_rows);
+
+            touched.clear();
+            for(std::size_t j=inner[first_row]; j<inner[last_row]; ++j){
+                std::size_t bc= outer[j]/C;
+                if(marker[bc]==npos){
+                    marker[bc]=0;
+                    touched.push_back(bc);
+                }
+            }
+            std::sort(touched.begin(), touched.end());
+
+            std::size_t base= m_block_outer.size();
+            for(std::size_t k=0; k<touched.size(); ++k){
+                marker[touched[k]]= base+k;
+                m_block_outer.push_back(touched[k]);
+            }
+            m_block_inner[br+1]= m_block_outer.size();
+            m_block_values.resize(m_block_outer.size()*R*C, T{});
+
+            for(std::size_t i=first_row; i<last_row; ++i)
+                for(std::size_t j=inner[i]; j<inner[i+1]; ++j)
+                    m_block_values[marker[outer[j]/C]*R*C + (i-first_row)*C + outer[j]%C]= values[j];
+
+            for(std::size_t bc: touched)
+                marker[bc]= npos;
+        }
+    }
+};
+
+/**
+ * @brief Converts the block format to a compressed SparseMatrix.
+ *
+ * The zeros stored for filling the blocks are skipped, so the result has the pattern of the original matrix
+ * unless it stored explicit zeros.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam R The number of rows of a block.
+ * @tparam C The number of columns of a block.
+ * @tparam s The storage order of the result.
+ * @return The compressed SparseMatrix.
+ */
+template <class T, std::size_t R, std::size_t C>
+template <StorageOrder s>
+SparseMatrix<T,s> BlockSparseMatrix<T,R,C>::toSparseMatrix() const {
+    std::vector<Triplet<T>> triplets;
+    triplets.reserve(m_nnz);
+    for(std::size_t br=0; br+1<m_block_inner.size(); ++br)
+        for(std::size_t b=m_block_inner[br]; b<m_block_inner[br+1]; ++b)
+            for(std::size_t r=0; r<R; ++r)
+                for(std::size_t c=0; c<C; ++c){
+                    const T &value= m_block_values[b*R*C + r*C + c];
+                    if(value!=T{})
+                        triplets.push_back({br*R+r, m_block_outer[b]*C+c, value});
+                }
+    SparseMatrix<T,s> m(m_rows, m_cols);
+    m.setFromTriplets(triplets);
+    return m;
+};
+
+/**
+ * @brief Accesses the element at the specified position.
+ *
+ * The block is searched with a binary search among the blocks of its block row.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam R The number of rows of a block.
+ * @tparam C The number of columns of a block.
+ * @param r The row index of the element.
+ * @param c The column index of the element.
+ * @return The value of the element at the specified position.
+ */
+template <class T, std::size_t R, std::size_t C>
+T BlockSparseMatrix<T,R,C>::operator()(std::size_t r, std::size_t c) const {
+    if(r<m_rows && c<m_cols){
+        auto first= m_block_outer.begin()+m_block_inner[r/R];
+        auto last= m_block_outer.begin()+m_block_inner[r/R+1];
+        auto it= std::lower_bound(first, last, c/C);
+        if(it!=last && *it==c/C)
+            return m_block_values[(it-m_block_outer.begin())*R*C + (r%R)*C + c%C];
+        return T{};
+    }
+    std::cerr << "Indexes are out of range\n";
+    return T{};
+};
+
+/**
+ * @brief Performs the matrix-vector multiplication block by block.
+ *
+ * Every block row accumulates its R results in a local array, and every block is multiplied by the C elements of
+ * the vector it touches with loops of compile-time length, that the compiler unrolls and vectorizes.
+ * Only one column index is read per block. If the number of columns is not a multiple of C, the vector is
+ * copied and padded with zeros.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam R The number of rows of a block.
+ * @tparam C The number of columns of a block.
+ * @param m The block sparse matrix.
+ * @param v The vector.
+ * @return The resulting vector of the matrix-vector multiplication.
+ */
+template <class U, std::size_t R, std::size_t C>
+std::vector<U> operator*(const BlockSparseMatrix<U,R,C> &m, const std::vector<U> &v){
+
+    if(m.m_cols!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+
+    std::vector<U> padded;
+    const U *x= v.data();
+    if(m.m_cols%C){
+        padded.assign((m.m_cols+C-1)/C*C, U{});
+        std::copy(v.begin(), v.end(), padded.begin());
+        x= padded.data();
+    }
+
+    std::vector<U> res(m.m_rows);
+    const U *values= m.m_block_values.data();
+    for(std::size_t br=0; br+1<m.m_block_inner.size(); ++br){
+        std::array<U,R> acc{};
+        for(std::size_t b=m.m_block_inner[br]; b<m.m_block_inner[br+1]; ++b){
+            const U *block= values + b*R*C;
+            const U *xb= x + m.m_block_outer[b]*C;
+            for(std::size_t r=0; r<R; ++r)
+                for(std::size_t c=0; c<C; ++c)
+                    acc[r]+= block[r*C+c]*xb[c];
+        }
+        std::size_t n= std::min(R, m.m_rows-br*R);
+        std::copy(acc.begin(), acc.begin()+n, res.begin()+br*R);
+    }
+
+    return res;
+};
+
+};
+
+
+#endif /*BLOCKSPARSEMATRIX_HPP*/
@@ -0,0 +1,124 @@
+#ifndef MAPPEDFILE_HPP
+#define MAPPEDFILE_HPP
+
+/**
+ * \file MappedFile.hpp
+ * \brief Read-only memory mapping of a file (POSIX)
+ */
+
+// clang-format off
+#include <algorithm>
+#include <cstddef>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace algebra{
+
+/**
+ * \brief RAII wrapper of a read-only, shared memory mapping of a whole file
+ * \note The mapping is released by the destructor, the object can be moved but not copied
+ */
+class MappedFile{
+
+public:
+
+    /**
+     * \brief Default constructor, no file is mapped
+     */
+    MappedFile()= default;
+
+    /**
+     * \brief Constructor, maps the whole file
+     * \param filename Name of the file to map
+     * \note If the file cannot be opened or mapped, an error is printed and is_open() returns false
+     */
+    explicit MappedFile(const std::string &filename){
+        int fd= ::open(filename.c_str(), O_RDONLY);
+        if(fd<0){
+            std::cerr << "Failed to open file: " << filename << std::endl;
+            return;
+        }
+        struct stat st;
+        if(::fstat(fd, &st)==0 && st.st_size>0){
+            void *p= ::mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+            if(p!=MAP_FAILED){
+                m_data= static_cast<const char*>(p);
+                m_size= st.st_size;
+            }
+            else
+                std::cerr << "Failed to map file: " << filename << std::endl;
+        }
+        //the mapping stays valid after closing the descriptor
+        ::close(fd);
+    };
+
+    MappedFile(const MappedFile &)= delete;
+    MappedFile & operator=(const MappedFile &)= delete;
+
+    MappedFile(MappedFile &&other) noexcept:
+        m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)) {};
+
+    MappedFile & operator=(MappedFile &&other) noexcept{
+        if(this!=&other){
+            unmap();
+            m_data= std::exchange(other.m_data, nullptr);
+            m_size= std::exchange(other.m_size, 0);
+        }
+        return *this;
+    };
+
+    ~MappedFile(){ unmap(); };
+
+    /**
+     * \brief Check if the file is mapped
+     * \return true if the mapping exists, false otherwise
+     */
+    bool is_open() const {return m_data!=nullptr;};
+
+    /**
+     * \brief Pointer to the first byte of the mapping
+     */
+    const char * data() const {return m_data;};
+
+    /**
+     * \brief Size of the mapping in bytes
+     */
+    std::size_t size() const {return m_size;};
+
+    /**
+     * \brief Tells the kernel how the range [offset, offset+length) will be accessed
+     * \param advice One of the MADV_* constants
+     * \param offset Offset of the range from the beginning of the file
+     * \param length Length of the range
+     */
+    void advise(int advice, std::size_t offset=0, std::size_t length=std::size_t(-1)) const {
+        if(!m_data || offset>=m_size)
+            return;
+        //madvise wants a page aligned address
+        std::size_t page= ::sysconf(_SC_PAGESIZE);
+        std::size_t begin= offset/page*page;
+        length= std::min(length, m_size-offset) + (offset-begin);
+        ::madvise(const_cast<char*>(m_data)+begin, length, advice);
+    };
+
+private:
+
+    const char *m_data=nullptr;
+    std::size_t m_size=0;
+
+    void unmap(){
+        if(m_data)
+            ::munmap(const_cast<char*>(m_data), m_size);
+    };
+
+};
+
+};
+
+
+#endif /*MAPPEDFILE_HPP*/
@@ -0,0 +1,423 @@
+#ifndef MAPPEDSPARSEMATRIX_HPP
+#define MAPPEDSPARSEMATRIX_HPP
+
+/**
+ * \file MappedSparseMatrix.hpp
+ * \brief Binary snapshot of a compressed SparseMatrix and read-only matrix mapped from it
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "MappedFile.hpp"
+#include "SparseMatrixView.hpp"
+#include <complex>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Header at the beginning of a snapshot file, followed by m_inner, m_outer and m_values
+ *
+ * The three arrays start at offsets multiple of 64 bytes, so that in the mapping they are aligned as in memory.
+ * Numbers are written with the byte order of the machine: endianness is 0x01020304 there, and reads differently
+ * on a machine with the other byte order.
+ */
+struct SnapshotHeader{
+    char magic[8];              //"ALGSPMAT"
+    std::uint32_t version;
+    std::uint32_t endianness;
+    std::uint32_t storage;      //StorageOrder
+    std::uint32_t value_type;   //snapshotTypeTag of the values
+    std::uint32_t value_size;
+    std::uint32_t index_size;
+    std::uint64_t rows, cols, nnz;
+    std::uint64_t inner_offset, outer_offset, values_offset;
+    std::uint64_t checksum;     //FNV-1a of the three arrays
+};
+
+static_assert(sizeof(SnapshotHeader)==88, "The snapshot header must have no padding");
+
+inline constexpr char snapshot_magic[8]= {'A','L','G','S','P','M','A','T'};
+inline constexpr std::uint32_t snapshot_version= 1;
+inline constexpr std::uint32_t snapshot_endianness= 0x01020304;
+inline constexpr std::size_t snapshot_alignment= 64;
+
+/**
+ * \brief Tag of a value type in the snapshot, 0 for the types without a tag (only their size is checked)
+ * \tparam T Type of the values
+ */
+template <class T>
+constexpr std::uint32_t snapshotTypeTag(){
+    if constexpr (std::is_same_v<T,float>) return 1;
+    else if constexpr (std::is_same_v<T,double>) return 2;
+    else if constexpr (std::is_same_v<T,long double>) return 3;
+    else if constexpr (std::is_same_v<T,std::complex<float>>) return 4;
+    else if constexpr (std::is_same_v<T,std::complex<double>>) return 5;
+    else if constexpr (std::is_integral_v<T>) return 16 + 2*sizeof(T) + std::is_signed_v<T>;
+    else return 0;
+};
+
+/**
+ * \brief FNV-1a hash of a buffer
+ * \param data The buffer
+ * \param size Its size in bytes
+ * \param hash The hash of the previous buffers, for hashing several buffers as one
+ * \return The hash
+ */
+inline std::uint64_t fnv1a(const char *data, std::size_t size, std::uint64_t hash=0xcbf29ce484222325ull){
+    for(std::size_t i=0; i<size; ++i){
+        hash^= static_cast<unsigned char>(data[i]);
+        hash*= 0x100000001b3ull;
+    }
+    return hash;
+};
+
+/**
+ * \brief First multiple of snapshot_alignment not smaller than offset
+ */
+inline std::uint64_t alignSnapshotOffset(std::uint64_t offset){
+    return (offset+snapshot_alignment-1)/snapshot_alignment*snapshot_alignment;
+};
+
+/**
+ * \brief Checks a snapshot header against the type of the matrix and the size of the file
+ *
+ * The header must have the magic string, the version and the byte order of this machine, and must describe
+ * a matrix with the storage order, value type and index size given, with dimensions and number of non-zero elements
+ * that fit in the index type. The arrays must lie inside the file.
+ *
+ * \tparam T Type of the values
+ * \tparam storage Storage order
+ * \tparam Index Type of the indexes
+ * \param header The header read from the file
+ * \param file_size Size of the file in bytes
+ * \return nullptr if the header is valid, the error message otherwise
+ */
+template <class T, StorageOrder storage, class Index>
+const char * checkSnapshotHeader(const SnapshotHeader &header, std::uint64_t file_size){
+    if(std::memcmp(header.magic, snapshot_magic, sizeof(header.magic))!=0)
+        return "Not a snapshot";
+    if(header.endianness!=snapshot_endianness)
+        return "Snapshot written with another byte order";
+    if(header.version!=snapshot_version)
+        return "Unsupported snapshot version";
+    if(header.storage!=storage)
+        return "Snapshot with another storage order";
+    if(header.value_type!=snapshotTypeTag<T>() || header.value_size!=sizeof(T) || header.index_size!=sizeof(Index))
+        return "Snapshot with other value or index types";
+
+    //n_inner must not wrap around, and the dimensions must be valid indexes of the view
+    std::uint64_t n_major= IsRowWise<storage>::value ? header.rows : header.cols;
+    if(n_major==std::numeric_limits<std::uint64_t>::max() || !fitsIndex<Index>(header.rows, header.cols, header.nnz))
+        return "Snapshot dimensions do not fit in the index type";
+    std::uint64_t n_inner= n_major + 1;
+    auto inside= [file_size](std::uint64_t offset, std::uint64_t count, std::size_t size){
+        return offset%snapshot_alignment==0 && offset<=file_size && count<=(file_size-offset)/size;
+    };
+    if(!inside(header.inner_offset, n_inner, sizeof(Index)) || !inside(header.outer_offset, header.nnz, sizeof(Index))
+       || !inside(header.values_offset, header.nnz, sizeof(T)))
+        return "Snapshot arrays out of the file";
+    return nullptr;
+};
+
+}
+
+/**
+ * @brief Writes a compressed SparseMatrix in a binary snapshot, to be loaded with MappedSparseMatrix.
+ *
+ * The file holds a versioned header (dimensions, storage order, value and index types, checksum) and the arrays
+ * m_inner, m_outer and m_values as they are in memory, aligned to 64 bytes.
+ *
+ * @tparam U The type of the matrix elements, trivially copyable.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, if it is uncompressed or has pending insertions a compressed copy is written.
+ * @param filename The name of the file to write.
+ * @return true if the file was written, false otherwise.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+bool writeSnapshot(const SparseMatrix<U,s,I,A> &m, const std::string &filename){
+    static_assert(std::is_trivially_copyable_v<U>, "Only trivially copyable values can be written");
+
+    if(!m.is_compressed() || m.pending()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return false;
+        return writeSnapshot(copy, filename);
+    }
+
+    auto inner= m.inner();
+    auto outer= m.outer();
+    auto values= m.values();
+
+    detail::SnapshotHeader header{};
+    std::memcpy(header.magic, detail::snapshot_magic, sizeof(header.magic));
+    header.version= detail::snapshot_version;
+    header.endianness= detail::snapshot_endianness;
+    header.storage= s;
+    header.value_type= detail::snapshotTypeTag<U>();
+    header.value_size= sizeof(U);
+    header.index_size= sizeof(I);
+    header.rows= m.rows();
+    header.cols= m.cols();
+    header.nnz= values.size();
+    header.inner_offset= detail::alignSnapshotOffset(sizeof(header));
+    header.outer_offset= detail::alignSnapshotOffset(header.inner_offset + inner.size_bytes());
+    header.values_offset= detail::alignSnapshotOffset(header.outer_offset + outer.size_bytes());
+    std::uint64_t hash= detail::fnv1a(reinterpret_cast<const char*>(inner.data()), inner.size_bytes());
+    hash= detail::fnv1a(reinterpret_cast<const char*>(outer.data()), outer.size_bytes(), hash);
+    header.checksum= detail::fnv1a(reinterpret_cast<const char*>(values.data()), values.size_bytes(), hash);
+
+    std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+    if(!file.is_open()){
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return false;
+    }
+    //writes a buffer after the zero padding that brings the file to offset
+    auto write_at= [&file](std::uint64_t offset, const void *data, std::size_t size){
+        static constexpr char zeros[detail::snapshot_alignment]= {};
+        file.write(zeros, offset - static_cast<std::uint64_t>(file.tellp()));
+        file.write(static_cast<const char*>(data), size);
+    };
+    file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    write_at(header.inner_offset, inner.data(), inner.size_bytes());
+    write_at(header.outer_offset, outer.data(), outer.size_bytes());
+    write_at(header.values_offset, values.data(), values.size_bytes());
+
+    if(!file){
+        std::cerr << "Failed to write file: " << filename << std::endl;
+        return false;
+    }
+    return true;
+};
+
+/**
+ * \brief Read-only compressed sparse matrix whose arrays point into the memory mapping of a snapshot file
+ *
+ * Loading maps the file written by writeSnapshot and checks its header: nothing is parsed nor copied, and
+ * processes that map the same file share the same physical pages. The mapping is released by the destructor,
+ * the object can be moved but not copied.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order, it must be the one of the snapshot
+ * \tparam Index Type of the indexes, it must have the size of the ones of the snapshot
+ */
+template <class T, StorageOrder storage, class Index = std::size_t>
+class MappedSparseMatrix{
+
+public:
+
+    /**
+     * \brief Constructor, maps a snapshot file
+     * \param filename Name of the file written by writeSnapshot
+     * \param verify true for checking the checksum of the arrays, which reads the whole file once; by default the header and the
+     *        bounds of m_inner and m_outer are checked, which is enough for safe accesses but not for detecting changed values
+     * \note If the file is not a valid snapshot of this type, an error is printed and is_open() returns false
+     */
+    explicit MappedSparseMatrix(const std::string &filename, bool verify=false);
+
+    /**
+     * \brief Check if the snapshot is mapped
+     * \return true if the snapshot was loaded, false otherwise
+     */
+    bool is_open() const {return m_file.is_open();};
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_view.rows();};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_view.cols();};
+
+    /**
+     * \brief Read-only access to m_inner, inside the mapping
+     */
+    std::span<const Index> inner() const {return m_view.inner();};
+
+    /**
+     * \brief Read-only access to m_outer, inside the mapping
+     */
+    std::span<const Index> outer() const {return m_view.outer();};
+
+    /**
+     * \brief Read-only access to m_values, inside the mapping
+     */
+    std::span<const T> values() const {return m_view.values();};
+
+    /**
+     * \brief Constant call operator
+     * \param r The row index
+     * \param c The column index
+     * \return The value at the specified position
+     */
+    T operator()(std::size_t r, std::size_t c) const {return m_view(r,c);};
+
+    /**
+     * \brief Implicit conversion to a view of the mapped arrays, valid while the MappedSparseMatrix exists
+     */
+    operator SparseMatrixView<T,storage,Index>() const {return m_view;};
+
+    /**
+     * \brief Overloading of the stream operator for MappedSparseMatrix
+     * \tparam U Type of the stored element
+     * \tparam s Storage order
+     * \tparam I Index type
+     * \param str The output stream
+     * \param m The MappedSparseMatrix object
+     * \return Reference to the output stream
+     */
+    template <class U, StorageOrder s, class I>
+    friend std::ostream & operator<<(std::ostream &str, const MappedSparseMatrix<U,s,I> &m);
+
+    /**
+     * \brief Product between a MappedSparseMatrix and a vector, with the kernels of SparseMatrixView
+     * \tparam U Type of the stored element
+     * \tparam s Storage order
+     * \tparam I Index type
+     * \param m The MappedSparseMatrix object
+     * \param v The vector, of size m.cols()
+     * \return The product vector
+     */
+    template <class U, StorageOrder s, class I>
+    friend std::vector<U> operator*(const MappedSparseMatrix<U,s,I> &m, const std::vector<U> &v);
+
+private:
+
+    MappedFile m_file;
+
+    /**
+     * \brief View of the arrays inside the mapping
+     */
+    SparseMatrixView<T,storage,Index> m_view;
+
+    /**
+     * \brief Private method to check the header of the mapped snapshot and build the view of the mapping
+     * \param filename Name of the file, for the error messages
+     * \param verify true for checking the checksum of the arrays
+     * \return true if the snapshot is valid, false otherwise
+     * \note Used inside the constructor
+     */
+    bool load(const std::string &filename, bool verify);
+
+};
+
+/**
+ * \brief Overloading of the stream operator for MappedSparseMatrix
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param str The output stream
+ * \param m The MappedSparseMatrix object
+ * \return Reference to the output stream
+ */
+template <class U, StorageOrder s, class I>
+std::ostream & operator<<(std::ostream &str, const MappedSparseMatrix<U,s,I> &m){
+    return str << m.m_view;
+};
+
+/**
+ * \brief Product between a MappedSparseMatrix and a vector, with the kernels of SparseMatrixView
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param m The MappedSparseMatrix object
+ * \param v The vector, of size m.cols()
+ * \return The product vector
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const MappedSparseMatrix<U,s,I> &m, const std::vector<U> &v){
+    return m.m_view*v;
+};
+
+/**
+ * @brief Maps a snapshot file and checks it, the mapping is released if the snapshot is not valid.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param filename The name of the snapshot file.
+ * @param verify true for checking the checksum of the arrays.
+ */
+template <class T, StorageOrder storage, class Index>
+MappedSparseMatrix<T,storage,Index>::MappedSparseMatrix(const std::string &filename, bool verify): m_file(filename) {
+    if(m_file.is_open() && !load(filename, verify))
+        m_file= MappedFile();
+};
+
+/**
+ * @brief Checks the header of the mapped snapshot and builds the view of the mapping.
+ *
+ * The header is checked by detail::checkSnapshotHeader, then m_inner must start at 0, never decrease and end at the
+ * number of non-zero elements, and m_outer must hold indexes smaller than the number of columns (rows), so that the
+ * accesses of the view stay inside the mapping: this reads m_inner and m_outer once, but not m_values.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param filename The name of the snapshot file, for the error messages.
+ * @param verify true for checking the checksum of the arrays.
+ * @return true if the snapshot is valid, false otherwise.
+ */
+template <class T, StorageOrder storage, class Index>
+bool MappedSparseMatrix<T,storage,Index>::load(const std::string &filename, bool verify){
+
+    auto fail= [&](const char *message){
+        std::cerr << message << ", file: " << filename << std::endl;
+        return false;
+    };
+
+    detail::SnapshotHeader header;
+    if(m_file.size()<sizeof(header))
+        return fail("File too short for a snapshot");
+    std::memcpy(&header, m_file.data(), sizeof(header));
+    if(const char *error= detail::checkSnapshotHeader<T,storage,Index>(header, m_file.size()))
+        return fail(error);
+
+    std::size_t n_inner= (IsRowWise<storage>::value ? header.rows : header.cols) + 1;
+
+    const char *base= m_file.data();
+    std::span<const Index> inner(reinterpret_cast<const Index*>(base+header.inner_offset), n_inner);
+    std::span<const Index> outer(reinterpret_cast<const Index*>(base+header.outer_offset), header.nnz);
+    std::span<const T> values(reinterpret_cast<const T*>(base+header.values_offset), header.nnz);
+    //the view reads m_outer and m_values in the ranges of m_inner and x at the indexes of m_outer, without checks
+    if(inner.front()!=0 || inner.back()!=header.nnz)
+        return fail("Corrupted snapshot");
+    for(std::size_t k=0; k+1<inner.size(); ++k)
+        if(inner[k+1]<inner[k])
+            return fail("Corrupted snapshot");
+    std::uint64_t n_minor= IsRowWise<storage>::value ? header.cols : header.rows;
+    for(Index j: outer)
+        if(j>=n_minor)
+            return fail("Corrupted snapshot");
+
+    if(verify){
+        std::uint64_t hash= detail::fnv1a(reinterpret_cast<const char*>(inner.data()), inner.size_bytes());
+        hash= detail::fnv1a(reinterpret_cast<const char*>(outer.data()), outer.size_bytes(), hash);
+        hash= detail::fnv1a(reinterpret_cast<const char*>(values.data()), values.size_bytes(), hash);
+        if(hash!=header.checksum)
+            return fail("Wrong snapshot checksum");
+    }
+
+    m_view= SparseMatrixView<T,storage,Index>(header.rows, header.cols, inner, outer, values);
+    return true;
+};
+
+};
+
+
+#endif /*MAPPEDSPARSEMATRIX_HPP*/
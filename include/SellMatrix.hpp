@@ -0,0 +1,285 @@
+#ifndef SELLMATRIX_HPP
+#define SELLMATRIX_HPP
+
+/**
+ * \file SellMatrix.hpp
+ * \brief Header file for the SellMatrix class (sliced ELLPACK, SELL-C-sigma format)
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <numeric>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Class to store sparse matrices in SELL-C-sigma (sliced ELLPACK) format
+ *
+ * The rows are sorted by decreasing number of non-zero elements inside windows of sigma rows, then packed in
+ * chunks of C consecutive rows. Every chunk is padded to the length of its longest row and stored column by column,
+ * so that the product handles the C rows of a chunk together, with loops of compile-time length C that the
+ * compiler can vectorize. The padding overhead tells if the format is convenient for a given matrix.
+ *
+ * \tparam T Type of the stored element
+ * \tparam C Number of rows of a chunk, usually the number of SIMD lanes (or a multiple)
+ */
+template <class T, std::size_t C = 8>
+class SellMatrix{
+
+    static_assert(C>0, "Chunks must have at least one row");
+
+public:
+
+    /**
+     * \brief Constructor from a SparseMatrix
+     * \tparam s Storage order of the SparseMatrix
+     * \tparam I Index type of the SparseMatrix
+     * \tparam A Assembly backend of the SparseMatrix
+     * \param m The SparseMatrix, if it is uncompressed or has pending insertions a compressed copy is used
+     * \param sigma Size of the sorting windows: 1 keeps the original order, the number of rows sorts all of them
+     */
+    template <StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    explicit SellMatrix(const SparseMatrix<T,s,I,A> &m, std::size_t sigma = 32*C);
+
+    /**
+     * \brief Constant call operator
+     * \param r The row index
+     * \param c The column index
+     * \return The value at the specified position
+     */
+    T operator()(std::size_t r, std::size_t c) const;
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_cols;};
+
+    /**
+     * \brief Number of stored elements, padding included
+     */
+    std::size_t storedElements() const {return m_values.size();};
+
+    /**
+     * \brief Padding overhead, (stored elements - non-zero elements)/non-zero elements
+     * \return 0 if no padding was needed
+     */
+    double paddingOverhead() const {return m_nnz ? double(m_values.size()-m_nnz)/m_nnz : 0.;};
+
+    /**
+     * \brief Function that executes the product between a SellMatrix and a vector, with compatible dimensions
+     * \tparam U Type of elements stored inside SellMatrix and std::vector
+     * \tparam CC Number of rows of a chunk
+     * \param m The SellMatrix object
+     * \param v The vector object
+     * \return The product vector of elements of type U
+     */
+    template <class U, std::size_t CC>
+    friend std::vector<U> operator*(const SellMatrix<U,CC> &m, const std::vector<U> &v);
+
+private:
+
+    std::size_t m_rows=0, m_cols=0;
+    //number of non-zero elements of the original matrix
+    std::size_t m_nnz=0;
+
+    /**
+     * \brief Original row of every sorted row
+     */
+    std::vector<std::size_t> m_row_perm;
+
+    /**
+     * \brief Sorted position of every original row, inverse of m_row_perm
+     */
+    std::vector<std::size_t> m_row_pos;
+
+    /**
+     * \brief Position of the first element of every chunk, the last element is the number of stored elements
+     */
+    std::vector<std::size_t> m_chunk_ptr;
+
+    /**
+     * \brief Number of non-zero elements of every row
+     */
+    std::vector<std::size_t> m_row_len;
+
+    /**
+     * \brief Column index of the stored elements, column by column inside every chunk
+     */
+    std::vector<std::size_t> m_col_idx;
+
+    /**
+     * \brief Stored elements, column by column inside every chunk, the padding is 0
+     */
+    std::vector<T> m_values;
+
+};
+
+/**
+ * \brief Function that executes the product between a SellMatrix and a vector, with compatible dimensions
+ * \tparam U Type of elements stored inside SellMatrix and std::vector
+ * \tparam C Number of rows of a chunk
+ * \param m The SellMatrix object
+ * \param v The vector object
+ * \return The product vector of elements of type U
+ */
+template <class U, std::size_t C>
+std::vector<U> operator*(const SellMatrix<U,C> &m, const std::vector<U> &v);
+
+
+/**
+ * @brief Builds the SELL-C-sigma format from a SparseMatrix.
+ *
+ * Column-wise matrices are first converted to row-wise ones with changeStorageOrder. The rows are sorted by decreasing length inside
+ * windows of sigma rows (a stable sort, so equal rows keep their order), then every chunk of C sorted rows
+ * is stored column by column with the length of its longest row. Padding elements have value 0 and repeat
+ * the last column index of their row, so that the product reads memory already in cache.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam C The number of rows of a chunk.
+ * @tparam s The storage order of the SparseMatrix.
+ * @tparam I The index type of the SparseMatrix.
+ * @tparam A The assembly backend of the SparseMatrix.
+ * @param m The SparseMatrix.
+ * @param sigma The size of the sorting windows.
+ */
+template <class T, std::size_t C>
+template <StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SellMatrix<T,C>::SellMatrix(const SparseMatrix<T,s,I,A> &m, std::size_t sigma): m_rows(m.rows()), m_cols(m.cols()) {
+
+    if constexpr (!IsRowWise<s>::value){
+        //the chunks need the matrix row by row
+        *this= SellMatrix(changeStorageOrder(m), sigma);
+    }
+    else if(!m.is_compressed() || m.pending()){
+        SparseMatrix<T,s,I,A> copy(m);
+        copy.compress();
+        if(copy.is_compressed() && !copy.pending()) //else too many elements for the index type
+            *this= SellMatrix(copy, sigma);
+    }
+    else{
+        auto inner= m.inner();
+        auto outer= m.outer();
+        auto values= m.values();
+        m_nnz= values.size();
+        sigma= std::max<std::size_t>(sigma, 1);
+
+        m_row_len.resize(m_rows);
+        for(std::size_t i=0; i<m_rows; ++i)
+            m_row_len[i]= inner[i+1]-inner[i];
+
+        //sort by decreasing length inside every window of sigma rows
+        m_row_perm.resize(m_rows);
+        std::iota(m_row_perm.begin(), m_row_perm.end(), 0);
+        for(std::size_t w=0; w<m_rows; w+=sigma)
+            std::stable_sort(m_row_perm.begin()+w, m_row_perm.begin()+std::min(w+sigma, m_rows),
+                             [this](std::size_t a, std::size_t b){ return m_row_len[a]>m_row_len[b]; });
+        m_row_pos.resize(m_rows);
+        for(std::size_t k=0; k<m_rows; ++k)
+            m_row_pos[m_row_perm[k]]= k;
+
+        //chunk widths
+        std::size_t n_chunks= (m_rows+C-1)/C;
+        m_chunk_ptr.assign(n_chunks+1, 0);
+        for(std::size_t c=0; c<n_chunks; ++c){
+            std::size_t width=0;
+            for(std::size_t k=c*C; k<std::min(c*C+C, m_rows); ++k)
+                width= std::max(width, m_row_len[m_row_perm[k]]);
+            m_chunk_ptr[c+1]= m_chunk_ptr[c] + width*C;
+        }
+
+        m_col_idx.assign(m_chunk_ptr[n_chunks], 0);
+        m_values.assign(m_chunk_ptr[n_chunks], T{});
+        for(std::size_t c=0; c<n_chunks; ++c){
+            std::size_t width= (m_chunk_ptr[c+1]-m_chunk_ptr[c])/C;
+            for(std::size_t lane=0; lane<C && c*C+lane<m_rows; ++lane){
+                std::size_t i= m_row_perm[c*C+lane];
+                std::size_t last_col=0;
+                for(std::size_t j=0; j<width; ++j){
+                    std::size_t pos= m_chunk_ptr[c] + j*C + lane;
+                    if(j<m_row_len[i]){
+                        last_col= outer[inner[i]+j];
+                        m_values[pos]= values[inner[i]+j];
+                    }
+                    m_col_idx[pos]= last_col;
+                }
+            }
+        }
+    }
+};
+
+/**
+ * @brief Accesses the element at the specified position.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam C The number of rows of a chunk.
+ * @param r The row index of the element.
+ * @param c The column index of the element.
+ * @return The value of the element at the specified position.
+ */
+template <class T, std::size_t C>
+T SellMatrix<T,C>::operator()(std::size_t r, std::size_t c) const {
+    if(r<m_rows && c<m_cols){
+        std::size_t k= m_row_pos[r];
+        std::size_t first= m_chunk_ptr[k/C] + k%C;
+        for(std::size_t j=0; j<m_row_len[r]; ++j)
+            if(m_col_idx[first + j*C]==c)
+                return m_values[first + j*C];
+        return T{};
+    }
+    std::cerr << "Indexes are out of range\n";
+    return T{};
+};
+
+/**
+ * @brief Performs the matrix-vector multiplication chunk by chunk.
+ *
+ * The C rows of a chunk are accumulated together in a local array: every step of the loop over the chunk width
+ * reads C contiguous values and C contiguous column indexes. The padded slots (and the lanes past the last row)
+ * are masked with a select on the row length instead of a branch, since 0*x is NaN if x is infinite or NaN.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam C The number of rows of a chunk.
+ * @param m The SELL-C-sigma matrix.
+ * @param v The vector.
+ * @return The resulting vector of the matrix-vector multiplication.
+ */
+template <class U, std::size_t C>
+std::vector<U> operator*(const SellMatrix<U,C> &m, const std::vector<U> &v){
+
+    if(m.m_cols!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+
+    std::vector<U> res(m.m_rows);
+    const U *values= m.m_values.data();
+    const std::size_t *cols= m.m_col_idx.data();
+    const U *x= v.data();
+    for(std::size_t c=0; c+1<m.m_chunk_ptr.size(); ++c){
+        std::array<U,C> acc{};
+        std::array<std::size_t,C> len{};
+        for(std::size_t lane=0; lane<C && c*C+lane<m.m_rows; ++lane)
+            len[lane]= m.m_row_len[m.m_row_perm[c*C+lane]];
+        for(std::size_t j=0, pos=m.m_chunk_ptr[c]; pos<m.m_chunk_ptr[c+1]; ++j, pos+=C)
+            for(std::size_t lane=0; lane<C; ++lane)
+                acc[lane]+= j<len[lane] ? values[pos+lane]*x[cols[pos+lane]] : U{};
+        for(std::size_t lane=0; lane<C && c*C+lane<m.m_rows; ++lane)
+            res[m.m_row_perm[c*C+lane]]= acc[lane];
+    }
+
+    return res;
+};
+
+};
+
+
+#endif /*SELLMATRIX_HPP*/
@@ -7,9 +7,16 @@
  */
 
 #include <vector>
-#include <map>
 #include <array>
 #include <iostream>
+#include <string>
+#include <span>
+#include <functional>
+#include <type_traits>
+#include <limits>
+#include <memory_resource>
+#include "StridedView.hpp"
+#include "bfloat16.hpp"
 //@note good doxygen comments
 namespace algebra{
 
@@ -33,18 +40,26 @@ template <>
 struct IsRowWise<column_wise> : std::false_type {}; 
 
 /**
- * \brief Functor for operator < for std::array<std::size_t,2>
+ * \brief Template struct for the opposite storage order of S, e.g. the storage order of the transpose
+ * \tparam S StorageOrder
+ */
+template <StorageOrder S>
+struct OppositeOrder : std::integral_constant<StorageOrder, IsRowWise<S>::value ? column_wise : row_wise> {};
+
+/**
+ * \brief Functor for operator < for std::array<Index,2>
  * \tparam storage 
+ * \tparam Index Type of the row and column indexes
  */
-template <StorageOrder storage>
+template <StorageOrder storage, class Index = std::size_t>
 struct  lessOperator{
     /**
-     * \brief Operator () for comparing two std::array<std::size_t,2> objects
+     * \brief Operator () for comparing two std::array<Index,2> objects
      * \param lhs The left-hand side object
      * \param rhs The right-hand side object
      * \return true if lhs is less than rhs, false otherwise
      */
-    bool operator()(const std::array<std::size_t, 2>& lhs, const std::array<std::size_t, 2>& rhs) const {
+    bool operator()(const std::array<Index, 2>& lhs, const std::array<Index, 2>& rhs) const {
         bool index;
         if constexpr (IsRowWise<storage>::value) 
             index=0;
@@ -58,28 +73,120 @@ struct  lessOperator{
     }
 };
 
+/**
+ * \brief Entry (row, column, value) of a sparse matrix, used for assembling it in bulk
+ * \tparam T Type of the stored element
+ */
+template <class T>
+struct Triplet{
+    std::size_t row;
+    std::size_t col;
+    T value;
+};
+
+/**
+ * \brief Check if an index type can describe a matrix
+ * \tparam Index Unsigned integer type
+ * \param rows Number of rows
+ * \param cols Number of columns
+ * \param nnz Number of non-zero elements
+ * \return true if the three numbers fit in Index
+ */
+template <class Index>
+constexpr bool fitsIndex(std::size_t rows, std::size_t cols, std::size_t nnz=0){
+    constexpr std::size_t max= std::numeric_limits<Index>::max();
+    return rows<=max && cols<=max && nnz<=max;
+};
+
+/**
+ * \brief Shape policy of a product with a vector: any matrix, the result has one element per row
+ */
+struct GenericShape{
+    static constexpr bool transpose= false;
+    static constexpr bool compatible(std::size_t, std::size_t cols, std::size_t n){ return n==cols; };
+    static constexpr std::size_t resultSize(std::size_t rows, std::size_t){ return rows; };
+};
+
+/**
+ * \brief Shape policy of a product with a vector: square matrix, the vector and the result have the same size
+ */
+struct SquareShape{
+    static constexpr bool transpose= false;
+    static constexpr bool compatible(std::size_t rows, std::size_t cols, std::size_t n){ return rows==cols && n==cols; };
+    static constexpr std::size_t resultSize(std::size_t rows, std::size_t){ return rows; };
+};
+
+/**
+ * \brief Shape policy of a product with a vector: matrix of one column, i.e. a vector, and dot product with a vector
+ *        of one element per row, the result has one element
+ */
+struct ColumnShape{
+    static constexpr bool transpose= true;
+    static constexpr bool compatible(std::size_t rows, std::size_t cols, std::size_t n){ return cols==1 && n==rows; };
+    static constexpr std::size_t resultSize(std::size_t, std::size_t cols){ return cols; };
+};
+
+template <class T, StorageOrder storage, class Index>
+class MapAssembly;
+
+template <class T, StorageOrder storage, class Index>
+class HashAssembly;
+
+template <class V, StorageOrder storage, class Index>
+class SparseMatrixCursor;
+
 /**
  * \brief Class to store sparse matrices
  * \tparam T Type of the stored element 
  * \tparam storage Storage order
+ * \tparam Index Unsigned integer type of the stored indexes (m_inner, m_outer and the keys of the maps),
+ *         it must hold the number of rows, of columns and of non-zero elements (see fitsIndex)
+ * \tparam Assembly Container of the uncompressed state and of the pending insertions, MapAssembly or HashAssembly
+ *         (see AssemblyBackends.hpp)
  */
-template <class T, StorageOrder storage>
+template <class T, StorageOrder storage, class Index = std::size_t, template<class,StorageOrder,class> class Assembly = MapAssembly>
 class SparseMatrix{
 
+    static_assert(std::is_integral_v<Index> && std::is_unsigned_v<Index>, "Index must be an unsigned integer type");
+
 public:
 
+    /**
+     * \brief Type of the stored indexes
+     */
+    using index_type = Index;
+
     /**
      * \brief Constructor, uses the private resize(r,c) method
      * \param r Number of rows
      * \param c Number of columns
+     * \param assembly_resource Memory resource of the uncompressed state and of the pending insertions, e.g. an AssemblyArena
+     * \param compressed_resource Memory resource of m_inner, m_outer and m_values
+     * \note As for the std::pmr containers, a copy of the SparseMatrix uses the default resource
      */
-    SparseMatrix(std::size_t r, std::size_t c ): m_compressed(0) { resize(r, c);}; 
+    SparseMatrix(std::size_t r, std::size_t c, std::pmr::memory_resource *assembly_resource= std::pmr::get_default_resource(),
+                 std::pmr::memory_resource *compressed_resource= std::pmr::get_default_resource()):
+        m_compressed(0), m_data_uncompressed(assembly_resource), m_inner(compressed_resource), m_outer(compressed_resource),
+        m_values(compressed_resource), m_pending(assembly_resource) { resize(r, c);}; 
 
     /**
      * \brief Compress SparseMatrix, fill m_inner, m_outer, m_values
+     * \note If the SparseMatrix is already compressed, the pending insertions are merged (see finalize())
      */
     void compress();
 
+    /**
+     * \brief Merge the insertions staged in m_pending into m_inner, m_outer, m_values with one linear pass
+     * \note Does nothing if the SparseMatrix is uncompressed or there are no pending insertions
+     */
+    void finalize();
+
+    /**
+     * \brief Number of new elements inserted in the compressed SparseMatrix and not merged yet
+     * \return The number of pending insertions
+     */
+    std::size_t pending() const {return m_pending.size();};
+
     /**
      * \brief Unompress SparseMatrix, fill map m_data_uncompressed
      */
@@ -91,6 +198,45 @@ public:
      */
     bool is_compressed() const {return m_compressed;};
 
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_cols;};
+
+    /**
+     * \brief Read-only access to m_inner, empty if the SparseMatrix is uncompressed
+     */
+    std::span<const Index> inner() const {return m_inner;};
+
+    /**
+     * \brief Read-only access to m_outer, empty if the SparseMatrix is uncompressed
+     * \note The pending insertions are not included, see finalize()
+     */
+    std::span<const Index> outer() const {return m_outer;};
+
+    /**
+     * \brief Read-only access to m_values, empty if the SparseMatrix is uncompressed
+     * \note The pending insertions are not included, see finalize()
+     */
+    std::span<const T> values() const {return m_values;};
+
+    /**
+     * \brief Fill the SparseMatrix from a buffer of triplets, the previous content is discarded and the matrix becomes compressed
+     * \tparam Reduce Type of the binary operation that merges repeated entries
+     * \param triplets The (row, column, value) entries, in any order
+     * \param reduce Operation called as value=reduce(value, repeated) following the order of the buffer, sum by default
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \note Entries out of range are skipped. If the entries in range do not fit in the index type an error is printed
+     *       and the matrix is left empty and uncompressed
+     */
+    template <class Reduce = std::plus<T>>
+    void setFromTriplets(std::span<const Triplet<T>> triplets, Reduce reduce = Reduce{}, std::size_t n_threads=1);
+
     /**
      * \brief Constant version of call operator 
      * \param r The row index
@@ -111,18 +257,20 @@ public:
      * \brief Overloading of the stream operator for SparseMatrix
      * \tparam U Type of elements stored inside SparseMatrix and std::vector 
      * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
      * \param str The output stream
      * \param m The SparseMatrix object
      * \return Reference to the output stream
      */
-    template<class U, StorageOrder s>
-    friend std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s> & m);  
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s,I,A> & m);  
 
     /**
      * \brief Method to resize the sparse matrix 
      * \param r_dir New number of rows
      * \param c_dir New number of columns
-     * \note Used inside the constructor
+     * \note Used inside the constructor. The size is not changed if it does not fit in Index
      */
     void resize(std::size_t r_dir, std::size_t c_dir);
 
@@ -130,23 +278,187 @@ public:
      * \brief Function that executes the product between a SparseMatrix and a vector, with compatible dimensions
      * \tparam U Type of elements stored inside SparseMatrix and std::vector 
      * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
      * \param m The SparseMatrix object
      * \param v The vector object
      * \return The product vector of elements of type U
      */
-    template<class U, StorageOrder s>
-    friend std::vector<U> operator*(const SparseMatrix<U,s> &m, const std::vector<U> &v);
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend std::vector<U> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v);
+
+    /**
+     * \brief Function that executes the product between a SparseMatrix and a vector of another type (mixed precision)
+     * \tparam U Type of elements stored inside SparseMatrix
+     * \tparam X Type of elements of std::vector, in which the product is accumulated
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \param v The vector object
+     * \return The product vector of elements of type X
+     */
+    template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+        requires (!std::is_same_v<U,X>)
+    friend std::vector<X> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v);
+
+    /**
+     * \brief Function that executes the product between a compressed SparseMatrix and a vector on several threads
+     * \tparam U Type of elements stored inside SparseMatrix
+     * \tparam X Type of elements of std::vector, in which the product is accumulated, usually U
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \param v The vector object
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \return The product vector of elements of type X
+     */
+    template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend std::vector<X> parallelProduct(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v, std::size_t n_threads);
+
+    /**
+     * \brief Function that executes the product between a SparseMatrix and a dense block of vectors
+     * \tparam U Type of elements stored inside SparseMatrix and std::vector 
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \param X The dense block of k vectors, with m.cols() rows
+     * \param k The number of vectors
+     * \param layout Storage order of X and of the result (row_wise: row by row, column_wise: vector by vector)
+     * \return The dense block of the k products
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend std::vector<U> multiply(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &X, std::size_t k, StorageOrder layout);
+
+    /**
+     * \brief Function that executes y = alpha*m*x + beta*y (or with the transpose of m) in place
+     * \tparam U Type of elements stored inside SparseMatrix and the vectors
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param alpha Factor of the product
+     * \param m The SparseMatrix object
+     * \param x The input vector, contiguous or with a stride
+     * \param beta Factor of y
+     * \param y The output vector, contiguous or with a stride
+     * \param transpose true for multiplying by the transpose of m
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend void gemv(std::type_identity_t<U> alpha, const SparseMatrix<U,s,I,A> &m, StridedView<const std::type_identity_t<U>> x,
+                     std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose);
+
+    /**
+     * \brief Function that builds the transpose of a SparseMatrix, reusing its compressed vectors
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \return The compressed transpose, with the opposite storage order
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,OppositeOrder<s>::value,I,A> transpose(const SparseMatrix<U,s,I,A> &m);
+
+    /**
+     * \brief Function that converts a SparseMatrix to the opposite storage order with a counting sort
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \return The same matrix, compressed with the opposite storage order
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,OppositeOrder<s>::value,I,A> changeStorageOrder(const SparseMatrix<U,s,I,A> &m);
+
+    /**
+     * \brief Function that copies a SparseMatrix into one with another index type
+     * \tparam J New index type
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \return The same matrix, compressed, with indexes of type J
+     */
+    template<class J, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,s,J,A> changeIndexType(const SparseMatrix<U,s,I,A> &m);
+
+    /**
+     * \brief Function that copies a SparseMatrix into one with another value type
+     * \tparam V New value type
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \return The same matrix, compressed, with values converted to V
+     */
+    template<class V, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<V,s,I,A> castValues(const SparseMatrix<U,s,I,A> &m);
+
+    /**
+     * \brief Function that permutes the rows and the columns of a square SparseMatrix, P*A*P^T
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of SparseMatrix
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param m The SparseMatrix object
+     * \param permutation The permutation, permutation[k] is the old index of the new index k
+     * \return The compressed permuted matrix
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,s,I,A> permute(const SparseMatrix<U,s,I,A> &m, const std::vector<std::size_t> &permutation);
+
+    /**
+     * \brief Function that computes the product of two SparseMatrix (SpGEMM), in parallel
+     * \tparam U Type of stored elements
+     * \tparam s Storage order of a and of the result
+     * \tparam t Storage order of b
+     * \tparam I Index type of SparseMatrix
+     * \tparam A Assembly backend of SparseMatrix
+     * \param a The left SparseMatrix object
+     * \param b The right SparseMatrix object
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \return The compressed product, with the storage order of a
+     */
+    template<class U, StorageOrder s, StorageOrder t, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,s,I,A> sparseProduct(const SparseMatrix<U,s,I,A> &a, const SparseMatrix<U,t,I,A> &b, std::size_t n_threads);
+
 
 
     /**
      * \brief Function to read a matrix in a MatrixMarket format
      * \tparam U Type of stored elements
      * \tparam s Storage order
+     * \tparam I Index type, std::size_t by default
+     * \tparam A Assembly backend, MapAssembly by default
      * \param filename Name of file in which the matrix is written
      * \return Sparse matrix of elements of type U and storage order s
      */
-    template<class U, StorageOrder s>
-    friend SparseMatrix<U,s> readMatrixMarket(const std::string& filename);
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,s,I,A> readMatrixMarket(const std::string& filename);
+
+    /**
+     * \brief Function to read a matrix in a MatrixMarket format through a memory mapping, in parallel
+     * \tparam U Type of stored elements
+     * \tparam s Storage order
+     * \tparam I Index type, std::size_t by default
+     * \tparam A Assembly backend, MapAssembly by default
+     * \param filename Name of file in which the matrix is written
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \return Compressed sparse matrix of elements of type U and storage order s
+     */
+    template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    friend SparseMatrix<U,s,I,A> readMatrixMarketMapped(const std::string& filename, std::size_t n_threads);
+
+    /**
+     * \brief Element access that remembers the last position, it changes the values through m_values
+     */
+    template <class V, StorageOrder s, class I>
+    friend class SparseMatrixCursor;
 
 private:
 
@@ -154,66 +466,318 @@ private:
     bool m_compressed;
 
     /**
-     * \brief Map for uncompressed state of SparseMatrix that uses lessOperator for ordering
+     * \brief Container for uncompressed state of SparseMatrix, it gives the elements in lessOperator order when compressing
      */
     //@note the simplest way to account for column_wise and row_wise is to use a different comparison operator
     // for the map in the two cases. This way you avoid the complexity of having to exchange the row and column indexes,
     // which is error-prone and confusing.
-    std::map<std::array<std::size_t, 2>, T, lessOperator<storage>>  m_data_uncompressed;   
+    Assembly<T, storage, Index>  m_data_uncompressed;   
     
-    std::vector<std::size_t> m_inner;
-    std::vector<std::size_t> m_outer;
-    std::vector<T> m_values;   
+    std::pmr::vector<Index> m_inner;
+    std::pmr::vector<Index> m_outer;
+    std::pmr::vector<T> m_values;   
+
+    /**
+     * \brief Container of the elements added to a compressed SparseMatrix, waiting to be merged by finalize()
+     */
+    Assembly<T, storage, Index>  m_pending;
 
     /**
      * \brief Private method to add a new element inside a compressed SparseMatrix
      * \param r The row index
      * \param c The column index
-     * \return Reference to the new added element
+     * \return Reference to the new added element, staged in m_pending
      * \note Used in the non-const operator for the compressed case
      */
     T & insertElementCompressed(std::size_t r, std::size_t c);
 
+    /**
+     * \brief Private method to add the product of the pending insertions with a vector
+     * \tparam X Type of the vectors, T or a wider type
+     * \param res The product vector
+     * \param v The vector
+     * \note Used by the matrix-vector products in the compressed case
+     */
+    template <class X>
+    void addPendingProduct(std::vector<X> &res, const std::vector<X> &v) const;
+
+    /**
+     * \brief Private method to fill m_inner, m_outer, m_values from chunks of triplets with a counting sort
+     * \tparam Reduce Type of the binary operation that merges repeated entries
+     * \param chunks The chunks of triplets, each one is handled by its own thread
+     * \param reduce Operation that merges repeated entries
+     * \return true if the matrix was filled, false (and the matrix is left empty and uncompressed) if the entries do
+     *         not fit in the index type
+     * \note Used by setFromTriplets and readMatrixMarketMapped
+     */
+    template <class Reduce>
+    bool assembleCompressed(const std::vector<std::span<const Triplet<T>>> &chunks, Reduce reduce);
+
 };
 
 /**
  * \brief Overloading of the stream operator for SparseMatrix
  * \tparam U Type of elements stored inside SparseMatrix and std::vector 
  * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
  * \param str The output stream
  * \param m The SparseMatrix object
  * \return Reference to the output stream
  */
-template<class U, StorageOrder s>
-std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s> & m);
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s,I,A> & m);
 
 /**
  * \brief Function that executes the product between a SparseMatrix and a vector, with compatible dimensions
  * \tparam U Type of elements stored inside SparseMatrix and std::vector 
  * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
  * \param m The SparseMatrix object
  * \param v The vector object
  * \return The product vector of elements of type U
  */
-template<class U, StorageOrder s>
-std::vector<U> operator*(const SparseMatrix<U,s> &m, const std::vector<U> &v);
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that executes the product between a SparseMatrix and a vector of another type (mixed precision),
+ *        e.g. values stored in float or bfloat16 and a vector of double
+ * \tparam U Type of elements stored inside SparseMatrix
+ * \tparam X Type of elements of std::vector, in which the product is accumulated
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param v The vector object, with one element per column of m
+ * \return The product vector of elements of type X, empty if the dimensions are incompatible
+ */
+template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    requires (!std::is_same_v<U,X>)
+std::vector<X> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v);
+
+/**
+ * \brief Function that executes the product between a SparseMatrix and a vector, for a shape known at compile time
+ * \tparam Shape Shape policy: GenericShape, SquareShape or ColumnShape
+ * \tparam U Type of elements stored inside SparseMatrix and std::vector
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param v The vector object
+ * \return The product vector of elements of type U, empty if the dimensions do not match the shape
+ */
+template<class Shape, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> product(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that executes the dot product between a SparseMatrix of one column and a vector
+ * \tparam U Type of elements stored inside SparseMatrix and std::vector
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object, with one column
+ * \param v The vector object, with one element per row of m
+ * \return The dot product, the default value of U if the dimensions are incompatible
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+U dot(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that executes the product between a compressed SparseMatrix and a vector on several threads
+ * \tparam U Type of elements stored inside SparseMatrix
+ * \tparam X Type of elements of std::vector, in which the product is accumulated, usually U
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param v The vector object
+ * \param n_threads Number of threads, 0 means one per hardware thread
+ * \return The product vector of elements of type X
+ */
+template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<X> parallelProduct(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v, std::size_t n_threads=0);
+
+/**
+ * \brief Function that executes the product between a SparseMatrix and a dense block of vectors
+ * \tparam U Type of elements stored inside SparseMatrix and std::vector 
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param X The dense block of k vectors, with m.cols() rows
+ * \param k The number of vectors
+ * \param layout Storage order of X and of the result (row_wise: row by row, column_wise: vector by vector)
+ * \return The dense block of the k products
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> multiply(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &X, std::size_t k, StorageOrder layout=row_wise);
+
+/**
+ * \brief Function that executes y = alpha*m*x + beta*y (or with the transpose of m) in place
+ * \tparam U Type of elements stored inside SparseMatrix and the vectors
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param alpha Factor of the product
+ * \param m The SparseMatrix object
+ * \param x The input vector, contiguous or with a stride
+ * \param beta Factor of y
+ * \param y The output vector, contiguous or with a stride
+ * \param transpose true for multiplying by the transpose of m
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+void gemv(std::type_identity_t<U> alpha, const SparseMatrix<U,s,I,A> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose=false);
+
+/**
+ * \brief Function that executes the product between the transpose of a SparseMatrix and a vector
+ * \tparam U Type of elements stored inside SparseMatrix and std::vector 
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param v The vector object, with m.rows() elements
+ * \return The product vector of elements of type U, with m.cols() elements
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> transposeProduct(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that builds the transpose of a SparseMatrix, reusing its compressed vectors
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \return The compressed transpose, with the opposite storage order
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,OppositeOrder<s>::value,I,A> transpose(const SparseMatrix<U,s,I,A> &m);
+
+/**
+ * \brief Function that converts a SparseMatrix to the opposite storage order with a counting sort
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \return The same matrix, compressed with the opposite storage order
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,OppositeOrder<s>::value,I,A> changeStorageOrder(const SparseMatrix<U,s,I,A> &m);
+
+/**
+ * \brief Function that copies a SparseMatrix into one with another index type
+ * \tparam J New index type
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \return The same matrix, compressed, with indexes of type J, or an empty matrix if it does not fit in J
+ */
+template<class J, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,J,A> changeIndexType(const SparseMatrix<U,s,I,A> &m);
+
+/**
+ * \brief Function that copies a SparseMatrix into one with another value type, e.g. float or bfloat16 for a
+ *        matrix multiplied by vectors of double
+ * \tparam V New value type
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \return The same matrix, compressed, with values converted to V, or an empty matrix if it does not fit in I
+ */
+template<class V, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<V,s,I,A> castValues(const SparseMatrix<U,s,I,A> &m);
+
+/**
+ * \brief Function that permutes the rows and the columns of a square SparseMatrix with the same permutation, P*A*P^T
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of SparseMatrix
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param m The SparseMatrix object
+ * \param permutation The permutation, permutation[k] is the old index of the new index k
+ * \return The compressed permuted matrix, or an empty matrix if the dimensions are incompatible or permutation is not a permutation
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> permute(const SparseMatrix<U,s,I,A> &m, const std::vector<std::size_t> &permutation);
+
+/**
+ * \brief Function that computes the product of two SparseMatrix (SpGEMM), in parallel, with a symbolic and a
+ *        numeric pass; b is converted to the storage order of a if it differs
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of a and of the result
+ * \tparam t Storage order of b
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param a The left SparseMatrix object
+ * \param b The right SparseMatrix object
+ * \param n_threads Number of threads, 0 means one per hardware thread
+ * \return The compressed product, with the storage order of a, or an empty matrix if the dimensions are incompatible
+ */
+template<class U, StorageOrder s, StorageOrder t, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> sparseProduct(const SparseMatrix<U,s,I,A> &a, const SparseMatrix<U,t,I,A> &b, std::size_t n_threads=0);
+
+/**
+ * \brief Overload of operator* for the product of two SparseMatrix, see sparseProduct
+ * \tparam U Type of stored elements
+ * \tparam s Storage order of a and of the result
+ * \tparam t Storage order of b
+ * \tparam I Index type of SparseMatrix
+ * \tparam A Assembly backend of SparseMatrix
+ * \param a The left SparseMatrix object
+ * \param b The right SparseMatrix object
+ * \return The compressed product, with the storage order of a
+ */
+template<class U, StorageOrder s, StorageOrder t, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> operator*(const SparseMatrix<U,s,I,A> &a, const SparseMatrix<U,t,I,A> &b);
 
 /**
  * \brief Function to read a matrix in a MatrixMarket format
  * \tparam U Type of stored elements
  * \tparam s Storage order
+ * \tparam I Index type, std::size_t by default
+ * \tparam A Assembly backend, MapAssembly by default
  * \param filename Name of file in which the matrix is written
  * \return Sparse matrix of elements of type U and storage order s
  */
-template<class U, StorageOrder s>
-SparseMatrix<U,s> readMatrixMarket(const std::string& filename);
+template<class U, StorageOrder s, class I = std::size_t, template<class,StorageOrder,class> class A = MapAssembly>
+SparseMatrix<U,s,I,A> readMatrixMarket(const std::string& filename);
+
+/**
+ * \brief Function to read a matrix in a MatrixMarket format through a memory mapping, in parallel
+ * \tparam U Type of stored elements
+ * \tparam s Storage order
+ * \tparam I Index type, std::size_t by default
+ * \tparam A Assembly backend, MapAssembly by default
+ * \param filename Name of file in which the matrix is written
+ * \param n_threads Number of threads, 0 means one per hardware thread
+ * \return Compressed sparse matrix of elements of type U and storage order s
+ */
+template<class U, StorageOrder s, class I = std::size_t, template<class,StorageOrder,class> class A = MapAssembly>
+SparseMatrix<U,s,I,A> readMatrixMarketMapped(const std::string& filename, std::size_t n_threads=0);
 
 
 };
 
 
+#include "AssemblyBackends.hpp"
 #include "SparseMatrixImpl.hpp"
 #include "readMatrixMarket.hpp"
+#include "parallelProduct.hpp"
+#include "multiVectorProduct.hpp"
+#include "SparseMatrixView.hpp"
+#include "SparseMatrixCursor.hpp"
+#include "gemv.hpp"
+#include "transpose.hpp"
+#include "sparseProduct.hpp"
+#include "reordering.hpp"
 
 
 
@@ -0,0 +1,191 @@
+#ifndef SPARSEMATRIXCURSOR_HPP
+#define SPARSEMATRIXCURSOR_HPP
+
+/**
+ * \file SparseMatrixCursor.hpp
+ * \brief Element access to a compressed matrix that remembers the last position, for sequential accesses
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "SparseMatrixView.hpp"
+#include "searchUtilities.hpp"
+#include <iostream>
+#include <limits>
+#include <span>
+#include <type_traits>
+
+namespace algebra{
+
+/**
+ * \brief Element access to a compressed (CSR or CSC) matrix that remembers the row (column) and the position of
+ *        the last access
+ *
+ * An access in the same row (column) as the previous one, to the same index or to the next stored one, costs O(1),
+ * e.g. walking a row in increasing column order; any other access is a search in the row (see
+ * detail::lowerBoundOuter). Built from a SparseMatrix, the values can be changed through find(); built from a
+ * SparseMatrixView they are read-only.
+ * The cursor is invalidated by any change of the pattern of the matrix (insertions, compress, uncompress, resize).
+ *
+ *     SparseMatrixCursor cursor(m);
+ *     for(std::size_t c=0; c<m.cols(); ++c)
+ *         if(double *value= cursor.find(r, c))
+ *             *value= 0.;
+ *
+ * \tparam V Type of the stored element, const for a read-only cursor
+ * \tparam storage Storage order
+ * \tparam Index Type of the indexes
+ */
+template <class V, StorageOrder storage, class Index = std::size_t>
+class SparseMatrixCursor{
+
+public:
+
+    using value_type= std::remove_const_t<V>;
+
+    /**
+     * \brief Constructor from a SparseMatrix, whose values can be changed through the cursor
+     * \param m The SparseMatrix, its pending insertions are merged (see SparseMatrix::finalize())
+     * \note If m is uncompressed, an error is printed and the cursor is empty
+     */
+    template <template<class,StorageOrder,class> class Assembly>
+    requires (!std::is_const_v<V>)
+    explicit SparseMatrixCursor(SparseMatrix<V,storage,Index,Assembly> &m);
+
+    /**
+     * \brief Constructor from a SparseMatrixView, read-only
+     * \param view The SparseMatrixView, whose buffers must outlive the cursor
+     */
+    explicit SparseMatrixCursor(const SparseMatrixView<value_type,storage,Index> &view) requires std::is_const_v<V>:
+        m_rows(view.rows()), m_cols(view.cols()), m_inner(view.inner()), m_outer(view.outer()), m_values(view.values().data()) {};
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_cols;};
+
+    /**
+     * \brief Stored element at a position
+     * \param r The row index
+     * \param c The column index
+     * \return Pointer to the value, nullptr if the element is not stored (or the indexes are out of range)
+     */
+    V * find(std::size_t r, std::size_t c);
+
+    /**
+     * \brief Value at a position
+     * \param r The row index
+     * \param c The column index
+     * \return The value, the default value of the type if the element is not stored
+     */
+    value_type operator()(std::size_t r, std::size_t c){
+        V *value= find(r, c);
+        return value ? *value : value_type();
+    };
+
+private:
+
+    std::size_t m_rows=0, m_cols=0;
+    std::span<const Index> m_inner;
+    std::span<const Index> m_outer;
+    V *m_values=nullptr;
+
+    /**
+     * \brief Row (column) of the last access and lower bound of its index inside m_outer
+     */
+    std::size_t m_last_inner= std::numeric_limits<std::size_t>::max(), m_position=0;
+
+};
+
+/**
+ * \brief Deduction guide for the cursor of a SparseMatrix
+ */
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+SparseMatrixCursor(SparseMatrix<T,storage,Index,Assembly> &) -> SparseMatrixCursor<T,storage,Index>;
+
+/**
+ * \brief Deduction guide for the read-only cursor of a SparseMatrixView
+ */
+template <class T, StorageOrder storage, class Index>
+SparseMatrixCursor(const SparseMatrixView<T,storage,Index> &) -> SparseMatrixCursor<const T,storage,Index>;
+
+/**
+ * @brief Merges the pending insertions of the matrix and points the cursor to its compressed vectors.
+ *
+ * @tparam V The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ * @param m The compressed sparse matrix.
+ */
+template <class V, StorageOrder storage, class Index>
+template <template<class,StorageOrder,class> class Assembly>
+requires (!std::is_const_v<V>)
+SparseMatrixCursor<V,storage,Index>::SparseMatrixCursor(SparseMatrix<V,storage,Index,Assembly> &m){
+    if(!m.is_compressed()){
+        std::cerr << "Only a compressed SparseMatrix has a cursor\n";
+        return;
+    }
+    m.finalize();
+    m_rows= m.rows();
+    m_cols= m.cols();
+    m_inner= m.m_inner;
+    m_outer= m.m_outer;
+    m_values= m.m_values.data();
+};
+
+/**
+ * @brief Finds the stored element at a position, starting from the position of the last access.
+ *
+ * In the row (column) of the last access, the index is compared with the remembered lower bound and with the next
+ * stored index, so that repeated and increasing accesses cost O(1); otherwise, the search is restricted to the part
+ * of the row (column) on the proper side of the remembered position.
+ *
+ * @tparam V The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param r The row index of the element.
+ * @param c The column index of the element.
+ * @return Pointer to the value, nullptr if the element is not stored.
+ */
+template <class V, StorageOrder storage, class Index>
+V * SparseMatrixCursor<V,storage,Index>::find(std::size_t r, std::size_t c){
+    if(r>=m_rows || c>=m_cols){
+        std::cerr << "Indexes are out of range\n";
+        return nullptr;
+    }
+    std::size_t i= IsRowWise<storage>::value ? r : c;
+    std::size_t o= IsRowWise<storage>::value ? c : r;
+    std::size_t first= m_inner[i], last= m_inner[i+1];
+    const Index *outer= m_outer.data();
+
+    std::size_t position;
+    if(i!=m_last_inner)
+        position= detail::lowerBoundOuter(outer, first, last, o);
+    else if(m_position<last && outer[m_position]<o){
+        //forward: most often the next stored index
+        position= m_position+1;
+        if(position<last && outer[position]<o)
+            position= detail::lowerBoundOuter(outer, position+1, last, o);
+    }
+    else if(m_position==first || outer[m_position-1]<o)
+        position= m_position;
+    else
+        position= detail::lowerBoundOuter(outer, first, m_position, o);
+
+    m_last_inner= i;
+    m_position= position;
+    if(position<last && outer[position]==o)
+        return m_values+position;
+    return nullptr;
+};
+
+};
+
+
+#endif /*SPARSEMATRIXCURSOR_HPP*/
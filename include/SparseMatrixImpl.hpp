@@ -8,7 +8,12 @@
 
 // clang-format off
 #include "SparseMatrix.hpp"
+#include "threadUtilities.hpp"
+#include "simdKernels.hpp"
+#include "searchUtilities.hpp"
+#include "instrumentation.hpp"
 #include <iostream>
+#include <utility>
 //@note I do not know why your compiler doas not request <algorithm> for std::upper_bound
 #include <algorithm>
 
@@ -20,13 +25,22 @@ namespace algebra{
  * This function compresses the sparse matrix using either the CSR (Compressed Sparse Row) or CSC (Compressed Sparse Column) format.
  * It initializes the compressed data structures and populates them with the non-zero elements of the uncompressed data.
  * After compression, the matrix is marked as compressed and the uncompressed data is cleared.
+ * If the matrix is already compressed, the pending insertions are merged.
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  */
-template <class T, StorageOrder storage>
-void SparseMatrix<T, storage>::compress(){
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+void SparseMatrix<T,storage,Index,Assembly>::compress(){
+    ALGEBRA_TIME(compress);
+    finalize();
     if (!m_compressed) {
+        if(!fitsIndex<Index>(m_rows, m_cols, m_data_uncompressed.size())){
+            std::cerr << "The number of non-zero elements does not fit in the index type\n";
+            return;
+        }
         
         bool key_index;
         //initialize the compressed data
@@ -50,7 +64,8 @@ void SparseMatrix<T, storage>::compress(){
         int nnz=0;
    
         // following lessOperator ordering
-        for (const auto& [key, value] : m_data_uncompressed) { 
+        for (const auto *element : m_data_uncompressed.sorted()) { 
+            const auto& [key, value]= *element;
             //@note This code is very complex. It could have been done in a simpler way!
             nnz++;   
 
@@ -81,6 +96,8 @@ void SparseMatrix<T, storage>::compress(){
 
         //mark the matrix as compressed
         m_compressed = true;
+        ALGEBRA_COUNT(toCompressed);
+        ALGEBRA_VOLUME(compress, m_inner.size()*sizeof(Index) + m_values.size()*(sizeof(Index)+sizeof(T)), m_values.size());
 
         //clear the uncompressed data
         m_data_uncompressed.clear();
@@ -91,15 +108,21 @@ void SparseMatrix<T, storage>::compress(){
  * @brief Uncompresses the sparse matrix.
  * 
  * This function uncompresses the sparse matrix by converting it from the CSR or CSC format to the uncompressed format.
- * It initializes the uncompressed data structures and populates them with the non-zero elements of the compressed data.
- * After uncompression, the matrix is marked as uncompressed and the compressed data is cleared.
+ * It initializes the uncompressed data structures and populates them with the non-zero elements of the compressed data
+ * and with the pending insertions. After uncompression, the matrix is marked as uncompressed and the compressed data is cleared.
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  */
-template <class T, StorageOrder storage>
-void SparseMatrix<T,storage>::uncompress() {
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+void SparseMatrix<T,storage,Index,Assembly>::uncompress() {
+    ALGEBRA_TIME(uncompress);
     if (m_compressed) {
+        ALGEBRA_COUNT(toUncompressed);
+        ALGEBRA_VOLUME(uncompress, m_inner.size()*sizeof(Index) + m_values.size()*(sizeof(Index)+sizeof(T)),
+                       m_values.size() + m_pending.size());
 
         std::size_t start= m_inner[0], end;
         
@@ -112,17 +135,21 @@ void SparseMatrix<T,storage>::uncompress() {
 
                 //loop over the specified range to understand the elements' positions
                 for(std::size_t j=start; j<end; ++j){ //m_outer, m_values
-                    std::array<std::size_t,2> f;
+                    std::array<Index,2> f;
                     if constexpr(IsRowWise<storage>::value)
-                        f={i-1, m_outer[j]};
+                        f={static_cast<Index>(i-1), m_outer[j]};
                     else 
-                        f={m_outer[j],i-1};
-                    m_data_uncompressed.insert(std::make_pair(f,m_values[j]));
+                        f={m_outer[j], static_cast<Index>(i-1)};
+                    m_data_uncompressed[f]= m_values[j];
                 }
             }
                     
         }
 
+        //elements staged while compressed, never already stored
+        m_pending.forEach([this](const std::array<Index,2> &key, const T &value){ m_data_uncompressed[key]= value; });
+        m_pending.clear();
+
         //mark the matrix as uncompressed
         m_compressed = false;
 
@@ -142,24 +169,30 @@ void SparseMatrix<T,storage>::uncompress() {
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  * @param r_dir The new number of rows.
  * @param c_dir The new number of columns.
  */
-template<class T, StorageOrder storage>
-void SparseMatrix<T,storage>::resize(std::size_t r_dir, std::size_t c_dir){
+template<class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+void SparseMatrix<T,storage,Index,Assembly>::resize(std::size_t r_dir, std::size_t c_dir){
+
+    if(!fitsIndex<Index>(r_dir, c_dir)){
+        std::cerr << "Dimensions do not fit in the index type\n";
+        return;
+    }
+    ALGEBRA_TIME(resize);
 
+    //a compressed matrix leaves the compressed state
+    if(m_compressed)
+        ALGEBRA_COUNT(resizeUncompress);
     uncompress();
 
     //only if SparseMatrix shrinks
     if(r_dir<m_rows || c_dir<m_cols){
-        auto it=m_data_uncompressed.begin();
-        while(it!=m_data_uncompressed.end()){       
-            if(it->first[0]>=r_dir)
-               it=m_data_uncompressed.erase(it);    
-            else if(it->first[1]>=c_dir)
-               it=m_data_uncompressed.erase(it);
-            else ++it;
-        }
+        m_data_uncompressed.eraseIf([r_dir, c_dir](const std::array<Index,2> &key){
+            return key[0]>=r_dir || key[1]>=c_dir;
+        });
     }
 
     m_rows=r_dir;
@@ -172,29 +205,33 @@ void SparseMatrix<T,storage>::resize(std::size_t r_dir, std::size_t c_dir){
  * @brief Accesses the element at the specified position in the sparse matrix.
  * 
  * This function returns the value of the element at the specified position in the sparse matrix.
- * If the matrix is compressed, it uses the CSR or CSC format to access the element efficiently.
+ * If the matrix is compressed, it uses the CSR or CSC format to access the element efficiently: the row (column)
+ * is sorted, so it is searched in logarithmic time (see detail::lowerBoundOuter).
  * If the matrix is uncompressed, it uses the uncompressed data structure to access the element.
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  * @param r The row index of the element.
  * @param c The column index of the element.
  * @return The value of the element at the specified position.
  */
-template <class T, StorageOrder storage>
-T SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c) const{
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+T SparseMatrix<T,storage,Index,Assembly>::operator()(std::size_t r, std::size_t c) const{
 
     if (r<m_rows && c<m_cols){
     if (!m_compressed){
-           std::array<std::size_t,2> key={r,c};
-           auto it= m_data_uncompressed.find(key);
-           if(it!= m_data_uncompressed.end())
-              return it->second;
+           ALGEBRA_COUNT(assemblyAccess);
+           std::array<Index,2> key={static_cast<Index>(r), static_cast<Index>(c)};
+           const T *value= m_data_uncompressed.find(key);
+           if(value)
+              return *value;
            else
               return T();//@note prefer T{} to T() for default initialization.
         }
     else {
-        
+        ALGEBRA_COUNT(compressedAccess);
         std::size_t index_for_inner, index_for_outer;
         if constexpr (IsRowWise<storage>::value) {  // CSR
             index_for_inner=r;
@@ -209,10 +246,17 @@ T SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c) const{
         std::size_t start = m_inner[index_for_inner];
         std::size_t end = m_inner[index_for_inner+1];
         
-        //search for the column/row index_for_outer in the specified range
-        for (std::size_t i = start; i < end; ++i)
-            if (m_outer[i] == index_for_outer) 
-                return m_values[i];
+        //search for the column/row index_for_outer in the specified range, which is sorted
+        std::size_t i = detail::lowerBoundOuter(m_outer.data(), start, end, index_for_outer);
+        if (i < end && m_outer[i] == index_for_outer)
+            return m_values[i];
+
+        //the element may have been inserted after compression
+        if(!m_pending.empty()){
+            const T *value= m_pending.find({static_cast<Index>(r), static_cast<Index>(c)});
+            if(value)
+                return *value;
+        }
         
         return T();  //default value of T
     }}  
@@ -224,26 +268,30 @@ T SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c) const{
  * @brief Accesses the element at the specified position in the sparse matrix.
  * 
  * This function returns a reference to the element at the specified position in the sparse matrix.
- * If the matrix is compressed, it uses the CSR or CSC format to access the element efficiently.
+ * If the matrix is compressed, it uses the CSR or CSC format to access the element efficiently: the row (column)
+ * is sorted, so it is searched in logarithmic time (see detail::lowerBoundOuter).
  * If the matrix is uncompressed, it uses the uncompressed data structure to access the element.
  * If the element does not exist, it inserts a new element at the specified position and returns a reference to it.
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  * @param r The row index of the element.
  * @param c The column index of the element.
  * @return A reference to the element at the specified position.
  */
-template <class T, StorageOrder storage>
-T & SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c){
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+T & SparseMatrix<T,storage,Index,Assembly>::operator()(std::size_t r, std::size_t c){
 
     if (r<m_rows && c<m_cols){
     if (!m_compressed){
-           std::array<std::size_t,2> key={r,c};
+           ALGEBRA_COUNT(assemblyAccess);
+           std::array<Index,2> key={static_cast<Index>(r), static_cast<Index>(c)};
            return m_data_uncompressed[key] ;
         }
     else {
-        
+        ALGEBRA_COUNT(compressedAccess);
         std::size_t index_for_inner, index_for_outer;
         if constexpr (IsRowWise<storage>::value) { //CSR
             index_for_inner=r;
@@ -257,12 +305,12 @@ T & SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c){
         std::size_t start = m_inner[index_for_inner];
         std::size_t end = m_inner[index_for_inner+1];       
         
-        //search for the column/row index_for_outer in the specified range
-        for (std::size_t i = start; i < end; ++i) 
-            if (m_outer[i] == index_for_outer) 
-                return m_values[i];
+        //search for the column/row index_for_outer in the specified range, which is sorted
+        std::size_t i = detail::lowerBoundOuter(m_outer.data(), start, end, index_for_outer);
+        if (i < end && m_outer[i] == index_for_outer)
+            return m_values[i];
 
-        //if element is not present yet 
+        //if element is not present yet (or it is still pending)
         return insertElementCompressed(r,c);  
     }}
     std::cerr<<"Indexes are out of range";
@@ -274,130 +322,359 @@ T & SparseMatrix<T,storage>::operator()(std::size_t r, std::size_t c){
 /**
  * @brief Inserts a new element at the specified position in the compressed sparse matrix.
  * 
- * This function inserts a new element at the specified position in the compressed sparse matrix.
- * It finds the insertion point in the m_outer array for the specified row/column and adjusts the m_inner array accordingly.
- * It returns a reference to the newly inserted value.
+ * This function stages the new element in m_pending instead of shifting m_outer and m_values:
+ * the staged elements are merged all together by finalize(), so that k insertions cost O(nnz + k log k)
+ * instead of O(k nnz). Until then, the element operator and the products take m_pending into account.
+ * It returns a reference to the staged value, which stays valid until the merge.
  * 
  * @tparam T The type of the matrix elements.
  * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
  * @param r The row index of the element.
  * @param c The column index of the element.
  * @return A reference to the newly inserted value.
  */
-template <class T, StorageOrder storage>
-T & SparseMatrix<T, storage>::insertElementCompressed(std::size_t r, std::size_t c) {
-
-//@note This is very sophisticated!
-    std::size_t index_for_inner, index_for_outer;
-    if constexpr (IsRowWise<storage>::value) { // CSR 
-        index_for_inner=r;
-        index_for_outer=c;
-    } 
-    else { // CSC 
-        index_for_inner=c;
-        index_for_outer=r;  
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+T & SparseMatrix<T,storage,Index,Assembly>::insertElementCompressed(std::size_t r, std::size_t c) {
+    ALGEBRA_COUNT(insertCompressed);
+    std::array<Index,2> key={static_cast<Index>(r), static_cast<Index>(c)};
+    return m_pending[key];
+};
+
+/**
+ * @brief Merges the pending insertions in the compressed sparse matrix.
+ * 
+ * The pending elements are taken in lessOperator ordering, as the compressed vectors, so the two sequences are
+ * merged row by row (column by column) in one linear pass into new vectors.
+ * 
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ */
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+void SparseMatrix<T,storage,Index,Assembly>::finalize() {
+    if (!m_compressed || m_pending.empty())
+        return;
+    ALGEBRA_TIME(finalize);
+
+    constexpr std::size_t key_index= IsRowWise<storage>::value ? 0 : 1;
+    std::size_t nnz= m_values.size() + m_pending.size();
+    if(!fitsIndex<Index>(m_rows, m_cols, nnz)){
+        std::cerr << "The number of non-zero elements does not fit in the index type\n";
+        return;
+    }
+    std::pmr::vector<Index> outer(m_outer.get_allocator());
+    std::pmr::vector<T> values(m_values.get_allocator());
+    outer.reserve(nnz);
+    values.reserve(nnz);
+
+    const auto pending= m_pending.sorted();
+    auto it= pending.begin();
+    for(std::size_t i=0; i+1<m_inner.size(); ++i){
+        std::size_t j= m_inner[i], end= m_inner[i+1];
+        //the new start of the row/column
+        m_inner[i]= outer.size();
+        while(j<end || (it!=pending.end() && (*it)->first[key_index]==i)){
+            //pending elements are never already stored, so the indexes are always different
+            if(it!=pending.end() && (*it)->first[key_index]==i && (j==end || (*it)->first[!key_index]<m_outer[j])){
+                outer.push_back((*it)->first[!key_index]);
+                values.push_back((*it)->second);
+                ++it;
+            }
+            else{
+                outer.push_back(m_outer[j]);
+                values.push_back(m_values[j]);
+                ++j;
+            }
+        }
     }
+    m_inner.back()= outer.size();
+    //every stored element is moved to make room for the pending ones
+    ALGEBRA_VOLUME(finalize, m_values.size()*(sizeof(Index)+sizeof(T)) + outer.size()*(sizeof(Index)+sizeof(T)), m_values.size());
 
-    //find the insertion point in the m_outer array for the specified row/column
-    std::size_t insertPos; 
-    insertPos = std::upper_bound(m_outer.begin() + m_inner[index_for_inner], m_outer.begin() + m_inner[index_for_inner + 1], index_for_outer) - m_outer.begin();
+    m_outer.swap(outer);
+    m_values.swap(values);
+    m_pending.clear();
+};
+
+/**
+ * @brief Fills the sparse matrix from a buffer of triplets.
+ * 
+ * The buffer is split in n_threads chunks and passed to assembleCompressed, which builds the compressed
+ * format directly: the container of the uncompressed state is never used.
+ * 
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ * @tparam Reduce The type of the binary operation that merges repeated entries.
+ * @param triplets The (row, column, value) entries, in any order.
+ * @param reduce The operation called as value=reduce(value, repeated), in the order of the buffer.
+ * @param n_threads The number of threads, 0 means one per hardware thread.
+ */
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+template <class Reduce>
+void SparseMatrix<T,storage,Index,Assembly>::setFromTriplets(std::span<const Triplet<T>> triplets, Reduce reduce, std::size_t n_threads){
+    ALGEBRA_TIME(setFromTriplets);
+    ALGEBRA_VOLUME(setFromTriplets, triplets.size_bytes(), triplets.size());
+    n_threads= detail::threadCount(n_threads);
+    std::vector<std::size_t> bounds= detail::partitionEvenly(triplets.size(), n_threads);
+    std::vector<std::span<const Triplet<T>>> chunks;
+    for(std::size_t p=0; p<n_threads; ++p)
+        chunks.push_back(triplets.subspan(bounds[p], bounds[p+1]-bounds[p]));
+    assembleCompressed(chunks, reduce);
+};
 
-    //adjust m_inner after the insertion
-    for (std::size_t i = index_for_inner + 1; i < m_inner.size(); ++i) 
-        ++m_inner[i]; 
+/**
+ * @brief Fills m_inner, m_outer and m_values from chunks of triplets.
+ * 
+ * The triplets are bucketed by row (CSR) or column (CSC) with a counting sort, where every chunk is counted and
+ * scattered by its own thread. Chunks write in their order, so that the relative order of repeated entries is kept.
+ * Then every row/column is sorted by the other index, following lessOperator ordering, and the repeated entries
+ * are merged with reduce while they are copied in the compressed vectors.
+ * 
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ * @tparam Reduce The type of the binary operation that merges repeated entries.
+ * @param chunks The chunks of triplets.
+ * @param reduce The operation that merges repeated entries, it may be called concurrently.
+ * @return true if the matrix was filled, false (and the matrix is left empty) if the entries do not fit in Index.
+ */
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+template <class Reduce>
+bool SparseMatrix<T,storage,Index,Assembly>::assembleCompressed(const std::vector<std::span<const Triplet<T>>> &chunks, Reduce reduce){
+
+    constexpr bool row_wise_storage= IsRowWise<storage>::value;
+    std::size_t n_chunks= chunks.size();
+    std::size_t n_inner= row_wise_storage ? m_rows : m_cols;
+    auto in_range= [this](const Triplet<T> &e){ return e.row<m_rows && e.col<m_cols; };
+    //one thread per chunk
+    std::vector<std::size_t> chunk_bounds= detail::partitionEvenly(n_chunks, n_chunks);
+
+    //count the entries of every row/column, chunk by chunk
+    std::vector<std::vector<std::size_t>> counts(n_chunks);
+    detail::runChunks(chunk_bounds, [&](std::size_t t, std::size_t, std::size_t){
+        counts[t].assign(n_inner, 0);
+        for(const auto &e: chunks[t])
+            if(in_range(e))
+                ++counts[t][row_wise_storage ? e.row : e.col];
+    });
+
+    //counts become the position where every chunk writes its next entry of a row/column
+    std::vector<std::size_t> start(n_inner+1);
+    std::size_t pos=0;
+    for(std::size_t k=0; k<n_inner; ++k){
+        start[k]= pos;
+        for(std::size_t t=0; t<n_chunks; ++t)
+            pos+= std::exchange(counts[t][k], pos);
+    }
+    start[n_inner]= pos;
+    if(!fitsIndex<Index>(m_rows, m_cols, pos)){
+        std::cerr << "The number of non-zero elements does not fit in the index type\n";
+        //the previous content is discarded anyway, the matrix is left empty and uncompressed
+        m_data_uncompressed.clear();
+        m_pending.clear();
+        m_inner.clear();
+        m_outer.clear();
+        m_values.clear();
+        m_compressed= false;
+        return false;
+    }
 
-    //insert the new index
-    m_values.insert(m_values.begin() + insertPos, T{});
-    m_outer.insert(m_outer.begin() + insertPos, index_for_outer);
+    std::size_t n_skipped= 0;
+    for(const auto &chunk: chunks)
+        n_skipped+= chunk.size();
+    n_skipped-= pos;
+    if(n_skipped)
+        std::cerr << n_skipped << " entries out of range skipped\n";
+
+    std::vector<std::pair<std::size_t,T>> sorted(pos);
+    detail::runChunks(chunk_bounds, [&](std::size_t t, std::size_t, std::size_t){
+        for(const auto &e: chunks[t])
+            if(in_range(e)){
+                std::size_t key= row_wise_storage ? e.row : e.col;
+                sorted[counts[t][key]++]= {row_wise_storage ? e.col : e.row, e.value};
+            }
+        counts[t]= {};
+    });
+
+    //sort every row/column by the other index and count the distinct entries
+    std::vector<std::size_t> inner_bounds= detail::partitionByNnz(start, n_chunks);
+    std::pmr::vector<Index> unique(n_inner+1, m_inner.get_allocator());
+    detail::runChunks(inner_bounds, [&](std::size_t, std::size_t first, std::size_t last){
+        for(std::size_t k=first; k<last; ++k){
+            auto b= sorted.begin()+start[k], e= sorted.begin()+start[k+1];
+            std::stable_sort(b, e, [](const auto &x, const auto &y){ return x.first<y.first; });
+            for(auto it=b; it!=e; ++it)
+                unique[k+1]+= (it+1==e || (it+1)->first!=it->first);
+        }
+    });
+    for(std::size_t k=0; k<n_inner; ++k)
+        unique[k+1]+= unique[k];
+
+    m_data_uncompressed.clear();
+    m_pending.clear();
+    m_inner= std::move(unique);
+    m_outer.resize(m_inner[n_inner]);
+    m_values.resize(m_inner[n_inner]);
+    detail::runChunks(inner_bounds, [&](std::size_t, std::size_t first, std::size_t last){
+        for(std::size_t k=first; k<last; ++k){
+            std::size_t j= m_inner[k];
+            for(std::size_t i=start[k]; i<start[k+1]; ++j){
+                m_outer[j]= sorted[i].first;
+                T value= sorted[i].second;
+                //merge the repeated entries
+                for(++i; i<start[k+1] && sorted[i].first==m_outer[j]; ++i)
+                    value= reduce(value, sorted[i].second);
+                m_values[j]= value;
+            }
+        }
+    });
+    if(!m_compressed)
+        ALGEBRA_COUNT(toCompressed);
+    m_compressed= true;
+    return true;
+};
 
-    //return a reference to the newly inserted value
-    return m_values[insertPos];
+/**
+ * @brief Adds the product of the pending insertions with a vector.
+ * 
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ * @tparam X The type of the vectors, the values are converted to it.
+ * @param res The product vector.
+ * @param v The vector.
+ */
+template <class T, StorageOrder storage, class Index, template<class,StorageOrder,class> class Assembly>
+template <class X>
+void SparseMatrix<T,storage,Index,Assembly>::addPendingProduct(std::vector<X> &res, const std::vector<X> &v) const {
+    m_pending.forEach([&](const std::array<Index,2> &key, const T &value){ res[key[0]]+= static_cast<X>(value)*v[key[1]]; });
 };
 
 /**
- * @brief Performs matrix-vector multiplication.
+ * @brief Performs the product between the sparse matrix and a vector, for a shape chosen at compile time.
  * 
- * This function performs matrix-vector multiplication between the sparse matrix and the vector.
- * It returns the resulting vector.
+ * The shape policy checks the dimensions and sizes the result, then the product is computed by gemv: the
+ * storage order and the shape select, once per call, a gather or a scatter kernel whose loops have no branches.
+ * A ColumnShape product is the product with the transpose of a matrix of one column, i.e. a dot product.
  * 
+ * @tparam Shape The shape policy: GenericShape, SquareShape or ColumnShape.
  * @tparam U The type of the matrix and vector elements.
  * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
  * @param m The sparse matrix.
  * @param v The vector.
- * @return The resulting vector of the matrix-vector multiplication.
+ * @return The resulting vector, empty if the dimensions do not match the shape.
  */
-template<class U, StorageOrder s>
-std::vector<U> operator*(const SparseMatrix<U,s> &m, const std::vector<U> &v){  
-    
-    if(m.m_cols!=v.size()  && !(m.m_cols==1 && m.m_rows==v.size())){
+template<class Shape, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> product(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v){
+    if(!Shape::compatible(m.rows(), m.cols(), v.size())){
         std::cerr << "Dimensions are incompatible\n";
         return std::vector<U>();
     }
-    else{
-        std::vector<U> res(m.m_rows);
-        
-        bool one_column= (m.m_cols==1);
-        //the vector is actually a scalar if matrix has one column
-        //@note Quite smart! But it may be misleading. It would be better to have a separate operator* for the scalar case.
-        if(one_column) 
-           res.resize(1);
+    ALGEBRA_TIME(product);
+    std::vector<U> res(Shape::resultSize(m.rows(), m.cols()));
+    gemv(U(1), m, v, U(0), res, Shape::transpose);
+    return res;
+};
 
-        if(m.is_compressed()){
+/**
+ * @brief Performs the dot product between a sparse matrix of one column and a vector.
+ * 
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, with one column.
+ * @param v The vector, with one element per row of the matrix.
+ * @return The dot product, the default value of U if the dimensions are incompatible.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+U dot(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v){
+    std::vector<U> res= product<ColumnShape>(m, v);
+    return res.empty() ? U() : res[0];
+};
 
-          if(!one_column){
-            
-            if (IsRowWise<s>::value){ //CSR 
-                for(std::size_t i = 0; i < m.m_rows; ++i){
-                    U sum = U();
-                    std::size_t start = m.m_inner[i];
-                    std::size_t end = m.m_inner[i+1];
-                    for(std::size_t j = start; j < end; ++j){
-                        U val= m.m_values[j];
-                        std::size_t v_idx= m.m_outer[j];
-                        sum += val * v[v_idx];
-                    }
-                    res[i] = sum;
-                }
-            }
+/**
+ * @brief Performs matrix-vector multiplication.
+ * 
+ * This function performs matrix-vector multiplication between the sparse matrix and the vector.
+ * It returns the resulting vector. The matrix-vector case is computed by gemv, where the compressed CSR product
+ * uses simd::csrRows, which runs hand-written kernels for float and double, chosen at runtime for the CPU.
+ * A matrix of one column times a vector of one element per row is the dot product, with a result of dimension one.
+ * The shape is checked here once, then the product runs the kernels of product<GenericShape> or
+ * product<ColumnShape>.
+ * 
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix.
+ * @param v The vector.
+ * @return The resulting vector of the matrix-vector multiplication.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v){  
+    //the vector is actually a scalar if matrix has one column, unless v has one element, as the row of the matrix
+    if(ColumnShape::compatible(m.m_rows, m.m_cols, v.size()) && !GenericShape::compatible(m.m_rows, m.m_cols, v.size()))
+        return product<ColumnShape>(m, v);
+    return product<GenericShape>(m, v);
+} 
 
-            else{
-                for(std::size_t i=0; i< m.m_cols ; ++i){
-                    for(std::size_t j=m.m_inner[i]; j<m.m_inner[i+1]; ++j)
-                        res[m.m_outer[j]]+= m.m_values[j]*v[i];
-                }
-            }
-          }
-          else { //"vector"-vector
-              if(IsRowWise<s>::value){
-                for(std::size_t i=0; i< m.m_rows ; ++i){
-                    std::size_t start = m.m_inner[i];
-                    std::size_t end= m.m_inner[i+1];
-                    if(start!=end){
-                        U val= m.m_values[start];
-                        res[0] += val*v[i];
-                    }
-                }
-              }
-              else {
-                    for(std::size_t j=m.m_inner[0]; j<m.m_inner[1]; ++j)
-                        res[0]+= m.m_values[j]*v[m.m_outer[j]];              
-              }
+/**
+ * @brief Performs the matrix-vector multiplication with values stored in a narrower type than the vector.
+ * 
+ * Every value is converted to the type of the vector when it is read, so the products and the sums are done in X:
+ * a matrix stored in float (see castValues) times a vector of double reads half the bytes of values of a double
+ * matrix, one stored in bfloat16 a quarter, and accumulates in double. The compressed CSR product uses
+ * simd::csrRows, which widens float and bfloat16 values to double in registers; the CSC product scatters the
+ * columns. The pending insertions are added afterwards, uncompressed matrices loop over the map.
+ * 
+ * @tparam U The type of the matrix elements.
+ * @tparam X The type of the vector elements and of the sums.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix.
+ * @param v The vector, with one element per column of the matrix.
+ * @return The resulting vector of the matrix-vector multiplication, empty if the dimensions are incompatible.
+ */
+template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+    requires (!std::is_same_v<U,X>)
+std::vector<X> operator*(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v){
+    if(m.m_cols!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<X>();
+    }
+    ALGEBRA_TIME(product);
+    [[maybe_unused]] std::size_t nnz= m.m_compressed ? m.m_values.size()+m.m_pending.size() : m.m_data_uncompressed.size();
+    ALGEBRA_VOLUME(product, nnz*(sizeof(I)+sizeof(U)) + m.m_inner.size()*sizeof(I) + (m.m_rows+m.m_cols)*sizeof(X), nnz);
+
+    std::vector<X> res(m.m_rows);
+    if(m.m_compressed){
+        //an empty matrix has no inner array
+        std::size_t n_inner= m.m_inner.empty() ? 0 : m.m_inner.size()-1;
+        if constexpr (IsRowWise<s>::value)
+            simd::csrRows(0, n_inner, m.m_inner.data(), m.m_outer.data(), m.m_values.data(), v.data(), res.data());
+        else
+            for(std::size_t k=0; k<n_inner; ++k){
+                const X v_k= v[k];
+                for(std::size_t j=m.m_inner[k]; j<m.m_inner[k+1]; ++j)
+                    res[m.m_outer[j]]+= static_cast<X>(m.m_values[j])*v_k;
             }
-        }
-        else {  
-            if(!one_column) //matrix-vector
-              //loop over non-zero elements of the map
-              for(const auto &[key,value]: m.m_data_uncompressed)
-                res[key[0]]+= value*v[key[1]];
-            else //"vector"-vector
-              //loop over non-zero elements of the map
-              for(const auto &[key,value]: m.m_data_uncompressed)
-                res[0]+= value*v[key[0]];
-        }
-
-        return res;
+        m.addPendingProduct(res, v);
     }
-} 
+    else
+        m.m_data_uncompressed.forEach([&](const std::array<I,2> &key, const U &value){ res[key[0]]+= static_cast<X>(value)*v[key[1]]; });
+    return res;
+};
 
 
 
@@ -408,36 +685,111 @@ std::vector<U> operator*(const SparseMatrix<U,s> &m, const std::vector<U> &v){
  * 
  * \tparam U Type of the stored element
  * \tparam s Storage order of the SparseMatrix
+ * \tparam I Index type of the SparseMatrix
+ * \tparam A Assembly backend of the SparseMatrix
  * \param str The output stream
  * \param m The SparseMatrix object
  * \return Reference to the output stream
  * 
  */
-template<class U, StorageOrder s>
-std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s> & m){
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::ostream & operator<<(std::ostream &str, const SparseMatrix<U,s,I,A> & m){
 
     if(!m.m_compressed){
-        std::cout<< "Map: " <<std::endl;
-        for(auto it=m.m_data_uncompressed.begin(); it!= m.m_data_uncompressed.end(); ++it)
-            str << "(" << it->first[0] << "," << it->first[1] << "): " << it->second <<"\n";
+        str<< "Map: " <<std::endl;
+        for(const auto *element: m.m_data_uncompressed.sorted())
+            str << "(" << element->first[0] << "," << element->first[1] << "): " << element->second <<"\n";
     }
 
     else{
-        std::cout<< "\nm_inner: " <<std::endl;
+        str<< "\nm_inner: " <<std::endl;
         for(auto it=m.m_inner.begin(); it!= m.m_inner.end(); ++it)
             str << *it << " ";
-        std::cout<< "\nm_outer: " <<std::endl;
+        str<< "\nm_outer: " <<std::endl;
         for(auto it=m.m_outer.begin(); it!= m.m_outer.end(); ++it)
             str << *it << " ";
-        std::cout << "\nm_values: " << std::endl;
+        str << "\nm_values: " << std::endl;
         for(auto it=m.m_values.begin(); it!= m.m_values.end(); ++it)
             str << *it << " ";
+        if(!m.m_pending.empty()){
+            str<< "\nPending: " <<std::endl;
+            for(const auto *element: m.m_pending.sorted())
+                str << "(" << element->first[0] << "," << element->first[1] << "): " << element->second <<"\n";
+        }
     }
-    std::cout << "\n------------------------------\n";
+    str << "\n------------------------------\n";
 
     return str;
 };
 
+/**
+ * @brief Copies the sparse matrix into one with another index type.
+ *
+ * The compressed vectors are copied element by element, e.g. to halve the memory of the indexes with
+ * std::uint32_t, which is enough when the dimensions and the number of non-zero elements are below 2^32.
+ *
+ * @tparam J The new index type.
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @return The compressed matrix with indexes of type J, an empty matrix if it does not fit in J (see fitsIndex).
+ */
+template<class J, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,J,A> changeIndexType(const SparseMatrix<U,s,I,A> &m){
+    if(!m.m_compressed || !m.m_pending.empty()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return SparseMatrix<U,s,J,A>(0,0);
+        return changeIndexType<J>(copy);
+    }
+    if(!fitsIndex<J>(m.m_rows, m.m_cols, m.m_values.size())){
+        std::cerr << "The matrix does not fit in the index type\n";
+        return SparseMatrix<U,s,J,A>(0,0);
+    }
+    SparseMatrix<U,s,J,A> res(m.m_rows, m.m_cols);
+    res.m_inner.assign(m.m_inner.begin(), m.m_inner.end());
+    res.m_outer.assign(m.m_outer.begin(), m.m_outer.end());
+    res.m_values= m.m_values;
+    res.m_compressed= true;
+    return res;
+};
+
+/**
+ * @brief Copies the sparse matrix into one with another value type.
+ *
+ * The indexes are copied and every value is converted with static_cast, e.g. to float or bfloat16 for a matrix
+ * whose products with vectors of double are accumulated in double (see the mixed-precision operator*). A double
+ * converted to bfloat16 goes through float, so it may be rounded twice.
+ *
+ * @tparam V The new value type.
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @return The compressed matrix with values of type V, an empty matrix if the compressed copy does not fit in I.
+ */
+template<class V, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<V,s,I,A> castValues(const SparseMatrix<U,s,I,A> &m){
+    if(!m.m_compressed || !m.m_pending.empty()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return SparseMatrix<V,s,I,A>(0,0);
+        return castValues<V>(copy);
+    }
+    SparseMatrix<V,s,I,A> res(m.m_rows, m.m_cols);
+    res.m_inner.assign(m.m_inner.begin(), m.m_inner.end());
+    res.m_outer.assign(m.m_outer.begin(), m.m_outer.end());
+    res.m_values.resize(m.m_values.size());
+    std::transform(m.m_values.begin(), m.m_values.end(), res.m_values.begin(), [](const U &value){ return static_cast<V>(value); });
+    res.m_compressed= true;
+    return res;
+};
+
 
 
 };
@@ -0,0 +1,283 @@
+#ifndef SPARSEMATRIXVIEW_HPP
+#define SPARSEMATRIXVIEW_HPP
+
+/**
+ * \file SparseMatrixView.hpp
+ * \brief Header file for the SparseMatrixView class, a non-owning read-only compressed matrix
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "StridedView.hpp"
+#include "searchUtilities.hpp"
+#include <algorithm>
+#include <iostream>
+#include <span>
+#include <type_traits>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Non-owning, read-only compressed (CSR or CSC) sparse matrix over external buffers
+ *
+ * It holds the dimensions and three spans with the meaning of m_inner, m_outer and m_values of SparseMatrix,
+ * so that arrays coming from another allocator, from shared memory or from another library are used without
+ * copies. A compressed SparseMatrix converts to it implicitly. The buffers must outlive the view.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order
+ * \tparam Index Type of the indexes
+ */
+template <class T, StorageOrder storage, class Index = std::size_t>
+class SparseMatrixView{
+
+public:
+
+    /**
+     * \brief Default constructor, empty view of a 0x0 matrix
+     */
+    SparseMatrixView()= default;
+
+    /**
+     * \brief Constructor from the compressed arrays
+     * \param r Number of rows
+     * \param c Number of columns
+     * \param inner Starts of the rows (columns), of size r+1 (c+1), sorted, from 0 to the number of non-zeros
+     * \param outer Column (row) indexes of the non-zeros, sorted inside every row (column)
+     * \param values Values of the non-zeros
+     * \note If the sizes are not consistent, an error is printed and the view is empty
+     */
+    SparseMatrixView(std::size_t r, std::size_t c, std::span<const Index> inner, std::span<const Index> outer,
+                     std::span<const T> values);
+
+    /**
+     * \brief Implicit conversion from a compressed SparseMatrix
+     * \param m The SparseMatrix, if it is uncompressed an error is printed and the view is empty
+     * \note The pending insertions of m are not seen by the view, see SparseMatrix::finalize()
+     */
+    template <template<class,StorageOrder,class> class Assembly>
+    SparseMatrixView(const SparseMatrix<T,storage,Index,Assembly> &m);
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_cols;};
+
+    /**
+     * \brief Read-only access to the starts of the rows (columns)
+     */
+    std::span<const Index> inner() const {return m_inner;};
+
+    /**
+     * \brief Read-only access to the column (row) indexes
+     */
+    std::span<const Index> outer() const {return m_outer;};
+
+    /**
+     * \brief Read-only access to the values
+     */
+    std::span<const T> values() const {return m_values;};
+
+    /**
+     * \brief Constant call operator
+     * \param r The row index
+     * \param c The column index
+     * \return The value at the specified position
+     */
+    T operator()(std::size_t r, std::size_t c) const;
+
+    /**
+     * \brief Overloading of the stream operator for SparseMatrixView
+     * \tparam U Type of the stored element
+     * \tparam s Storage order
+     * \tparam I Index type
+     * \param str The output stream
+     * \param m The SparseMatrixView object
+     * \return Reference to the output stream
+     */
+    template <class U, StorageOrder s, class I>
+    friend std::ostream & operator<<(std::ostream &str, const SparseMatrixView<U,s,I> &m);
+
+private:
+
+    std::size_t m_rows=0, m_cols=0;
+    std::span<const Index> m_inner;
+    std::span<const Index> m_outer;
+    std::span<const T> m_values;
+
+};
+
+/**
+ * \brief Overloading of the stream operator for SparseMatrixView
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param str The output stream
+ * \param m The SparseMatrixView object
+ * \return Reference to the output stream
+ */
+template <class U, StorageOrder s, class I>
+std::ostream & operator<<(std::ostream &str, const SparseMatrixView<U,s,I> &m);
+
+/**
+ * \brief Function that executes the product between a SparseMatrixView and a vector
+ * \tparam U Type of elements stored inside SparseMatrixView and std::vector
+ * \tparam s Storage order of SparseMatrixView
+ * \tparam I Index type of SparseMatrixView
+ * \param m The SparseMatrixView object
+ * \param v The vector object
+ * \return The product vector of elements of type U
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const SparseMatrixView<U,s,I> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that executes y = alpha*m*x + beta*y (or with the transpose of m) in place, for a SparseMatrixView
+ * \tparam U Type of elements stored inside SparseMatrixView and the vectors
+ * \tparam s Storage order of SparseMatrixView
+ * \tparam I Index type of SparseMatrixView
+ * \param alpha Factor of the product
+ * \param m The SparseMatrixView object
+ * \param x The input vector, contiguous or with a stride
+ * \param beta Factor of y
+ * \param y The output vector, contiguous or with a stride
+ * \param transpose true for multiplying by the transpose of m
+ */
+template <class U, StorageOrder s, class I>
+void gemv(std::type_identity_t<U> alpha, const SparseMatrixView<U,s,I> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose=false);
+
+/**
+ * @brief Builds the view over the compressed arrays and checks their sizes.
+ *
+ * Only the sizes and the two ends of inner are checked, in constant time: the order of the indexes is trusted.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param r The number of rows.
+ * @param c The number of columns.
+ * @param inner The starts of the rows (columns).
+ * @param outer The column (row) indexes.
+ * @param values The values.
+ */
+template <class T, StorageOrder storage, class Index>
+SparseMatrixView<T,storage,Index>::SparseMatrixView(std::size_t r, std::size_t c, std::span<const Index> inner,
+                                                     std::span<const Index> outer, std::span<const T> values){
+    std::size_t n_inner= IsRowWise<storage>::value ? r : c;
+    if(inner.size()!=n_inner+1 || inner.front()!=0 || inner.back()!=outer.size() || outer.size()!=values.size()){
+        std::cerr << "Inconsistent compressed arrays\n";
+        return;
+    }
+    m_rows= r;
+    m_cols= c;
+    m_inner= inner;
+    m_outer= outer;
+    m_values= values;
+};
+
+/**
+ * @brief Builds the view over the compressed vectors of a SparseMatrix.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @tparam Assembly The assembly backend of the matrix.
+ * @param m The compressed sparse matrix.
+ */
+template <class T, StorageOrder storage, class Index>
+template <template<class,StorageOrder,class> class Assembly>
+SparseMatrixView<T,storage,Index>::SparseMatrixView(const SparseMatrix<T,storage,Index,Assembly> &m){
+    if(!m.is_compressed()){
+        std::cerr << "Only a compressed SparseMatrix has a view\n";
+        return;
+    }
+    m_rows= m.rows();
+    m_cols= m.cols();
+    m_inner= m.inner();
+    m_outer= m.outer();
+    m_values= m.values();
+};
+
+/**
+ * @brief Accesses the element at the specified position.
+ *
+ * The row (column) is sorted, so the element is found with a binary search (see detail::lowerBoundOuter).
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param r The row index of the element.
+ * @param c The column index of the element.
+ * @return The value of the element at the specified position.
+ */
+template <class T, StorageOrder storage, class Index>
+T SparseMatrixView<T,storage,Index>::operator()(std::size_t r, std::size_t c) const {
+    if(r>=m_rows || c>=m_cols){
+        std::cerr << "Indexes are out of range\n";
+        return T();
+    }
+    std::size_t i= IsRowWise<storage>::value ? r : c;
+    std::size_t o= IsRowWise<storage>::value ? c : r;
+    std::size_t last= m_inner[i+1];
+    std::size_t j= detail::lowerBoundOuter(m_outer.data(), m_inner[i], last, o);
+    if(j<last && m_outer[j]==o)
+        return m_values[j];
+    return T();
+};
+
+/**
+ * \brief Overload of the operator<< for the SparseMatrixView class, with the format of a compressed SparseMatrix
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param str The output stream
+ * \param m The SparseMatrixView object
+ * \return Reference to the output stream
+ */
+template <class U, StorageOrder s, class I>
+std::ostream & operator<<(std::ostream &str, const SparseMatrixView<U,s,I> &m){
+    str << "\nm_inner: " << std::endl;
+    for(auto i: m.m_inner)
+        str << i << " ";
+    str << "\nm_outer: " << std::endl;
+    for(auto o: m.m_outer)
+        str << o << " ";
+    str << "\nm_values: " << std::endl;
+    for(const auto &v: m.m_values)
+        str << v << " ";
+    str << "\n------------------------------\n";
+    return str;
+};
+
+/**
+ * @brief Performs the product between the view and a vector, with the kernels of gemv.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @param m The sparse matrix view.
+ * @param v The vector.
+ * @return The resulting vector of the matrix-vector multiplication.
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const SparseMatrixView<U,s,I> &m, const std::vector<U> &v){
+    if(m.cols()!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    std::vector<U> res(m.rows());
+    gemv(U(1), m, v, U(0), res);
+    return res;
+};
+
+};
+
+
+#endif /*SPARSEMATRIXVIEW_HPP*/
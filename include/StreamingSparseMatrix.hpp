@@ -0,0 +1,497 @@
+#ifndef STREAMINGSPARSEMATRIX_HPP
+#define STREAMINGSPARSEMATRIX_HPP
+
+/**
+ * \file StreamingSparseMatrix.hpp
+ * \brief Out-of-core product of a compressed matrix stored in a snapshot file, panel by panel
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "MappedSparseMatrix.hpp"
+#include "StridedView.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace algebra{
+
+/**
+ * \brief Read-only compressed matrix that stays on disk, in a snapshot file written by writeSnapshot
+ *
+ * For matrices larger than the memory: the products read the file in panels of consecutive rows (CSR) or
+ * columns (CSC), with large sequential reads, and the next panel is read by another thread while the current
+ * one is multiplied. The two panel buffers never exceed the memory budget given to the constructor, so that
+ * a row (column) too long for a panel is split between two panels. Only the vectors of the product are resident.
+ * The object can be moved but not copied.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order, it must be the one of the snapshot
+ * \tparam Index Type of the indexes, it must have the size of the ones of the snapshot
+ */
+template <class T, StorageOrder storage, class Index = std::size_t>
+class StreamingSparseMatrix{
+
+    static_assert(alignof(T)<=__STDCPP_DEFAULT_NEW_ALIGNMENT__, "The panel buffers are not aligned for T");
+
+public:
+
+    /**
+     * \brief Constructor, opens a snapshot file and plans the panels with one sequential read of m_inner
+     * \param filename Name of the file written by writeSnapshot
+     * \param memory_budget Bytes of the two panel buffers together, at least 4096
+     * \note If the file is not a valid snapshot of this type, an error is printed and is_open() returns false.
+     *       The checksum is not checked when opening, see verify()
+     */
+    explicit StreamingSparseMatrix(const std::string &filename, std::size_t memory_budget= std::size_t(64)<<20);
+
+    StreamingSparseMatrix(const StreamingSparseMatrix &)= delete;
+    StreamingSparseMatrix & operator=(const StreamingSparseMatrix &)= delete;
+
+    StreamingSparseMatrix(StreamingSparseMatrix &&other) noexcept{ *this= std::move(other); };
+
+    StreamingSparseMatrix & operator=(StreamingSparseMatrix &&other) noexcept{
+        if(this!=&other){
+            close();
+            m_fd= std::exchange(other.m_fd, -1);
+            m_header= other.m_header;
+            m_budget= other.m_budget;
+            m_cuts= std::move(other.m_cuts);
+            m_panel_bytes= other.m_panel_bytes;
+        }
+        return *this;
+    };
+
+    ~StreamingSparseMatrix(){ close(); };
+
+    /**
+     * \brief Check if the snapshot is open
+     */
+    bool is_open() const {return m_fd>=0;};
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_header.rows;};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_header.cols;};
+
+    /**
+     * \brief Number of non-zero elements
+     */
+    std::size_t nnz() const {return m_header.nnz;};
+
+    /**
+     * \brief Number of panels read by every product
+     */
+    std::size_t panels() const {return m_cuts.empty() ? 0 : m_cuts.size()-1;};
+
+    /**
+     * \brief Bytes of the two panel buffers together
+     */
+    std::size_t memoryBudget() const {return m_budget;};
+
+    /**
+     * \brief Checks the checksum of the arrays, reading the whole file once within the memory budget
+     * \return true if the checksum is right, false otherwise
+     */
+    bool verify() const;
+
+    /**
+     * \brief Function that executes y = alpha*m*x + beta*y (or with the transpose of m) in place, streaming m from disk
+     * \tparam U Type of the stored element
+     * \tparam s Storage order
+     * \tparam I Index type
+     * \param alpha Factor of the product
+     * \param m The StreamingSparseMatrix object
+     * \param x The input vector, contiguous or with a stride
+     * \param beta Factor of y
+     * \param y The output vector, contiguous or with a stride
+     * \param transpose true for multiplying by the transpose of m
+     * \return true if the whole matrix was read, false (and an error is printed) if a read failed
+     */
+    template <class U, StorageOrder s, class I>
+    friend bool gemv(std::type_identity_t<U> alpha, const StreamingSparseMatrix<U,s,I> &m, StridedView<const std::type_identity_t<U>> x,
+                     std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose);
+
+private:
+
+    /**
+     * \brief Start of a panel: the first row (column) of its slice of m_inner and its first non-zero element
+     */
+    struct Cut{
+        std::uint64_t inner;
+        std::uint64_t nnz;
+    };
+
+    /**
+     * \brief Buffer of a panel, allocated once for all the panels, and its slice of m_inner and ranges of m_outer
+     *        and m_values inside it
+     */
+    struct Panel{
+        std::unique_ptr<char[]> buffer;
+        const Index *inner= nullptr;
+        const Index *outer= nullptr;
+        const T *values= nullptr;
+    };
+
+    int m_fd=-1;
+    detail::SnapshotHeader m_header{};
+    std::size_t m_budget=0;
+
+    /**
+     * \brief Panel p holds the rows (columns) from m_cuts[p].inner to m_cuts[p+1].inner and the non-zero elements
+     *        from m_cuts[p].nnz to m_cuts[p+1].nnz; the last cut is {number of rows (columns), nnz}
+     */
+    std::vector<Cut> m_cuts;
+
+    /**
+     * \brief Bytes of the largest panel, at most half of the memory budget
+     */
+    std::size_t m_panel_bytes=0;
+
+    /**
+     * \brief Private method to read bytes at an offset of the file, with as many reads as needed
+     */
+    bool readAt(void *buffer, std::size_t bytes, std::uint64_t offset) const;
+
+    /**
+     * \brief Private method to read panel p into its buffer
+     */
+    bool readPanel(std::size_t p, Panel &panel) const;
+
+    /**
+     * \brief Private method to check the header and plan the panels, used inside the constructor
+     */
+    bool open(const std::string &filename);
+
+    void close(){
+        if(m_fd>=0)
+            ::close(m_fd);
+        m_fd= -1;
+    };
+
+};
+
+/**
+ * \brief Function that executes y = alpha*m*x + beta*y (or with the transpose of m) in place, streaming m from disk
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param alpha Factor of the product
+ * \param m The StreamingSparseMatrix object
+ * \param x The input vector, contiguous or with a stride
+ * \param beta Factor of y
+ * \param y The output vector, contiguous or with a stride
+ * \param transpose true for multiplying by the transpose of m
+ * \return true if the whole matrix was read, false (and an error is printed) if a read failed
+ */
+template <class U, StorageOrder s, class I>
+bool gemv(std::type_identity_t<U> alpha, const StreamingSparseMatrix<U,s,I> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose=false);
+
+/**
+ * \brief Product between a StreamingSparseMatrix and a vector
+ * \tparam U Type of the stored element
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \param m The StreamingSparseMatrix object
+ * \param v The vector, of size m.cols()
+ * \return The product vector, empty if the dimensions are incompatible or a read failed
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const StreamingSparseMatrix<U,s,I> &m, const std::vector<U> &v);
+
+/**
+ * @brief Opens a snapshot file and plans the panels.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param filename The name of the snapshot file.
+ * @param memory_budget The bytes of the two panel buffers together.
+ */
+template <class T, StorageOrder storage, class Index>
+StreamingSparseMatrix<T,storage,Index>::StreamingSparseMatrix(const std::string &filename, std::size_t memory_budget):
+    m_budget(memory_budget) {
+    if(m_budget<4096){
+        std::cerr << "Memory budget too small for streaming, at least 4096 bytes\n";
+        return;
+    }
+    m_fd= ::open(filename.c_str(), O_RDONLY);
+    if(m_fd<0){
+        std::cerr << "Failed to open file: " << filename << std::endl;
+        return;
+    }
+    if(!open(filename))
+        close();
+};
+
+/**
+ * @brief Checks the header and splits the matrix into panels that fit in half of the memory budget.
+ *
+ * m_inner is read once, in chunks, and the rows (columns) are added greedily to the current panel: a panel costs
+ * one index per entry of its slice of m_inner plus one index and one value per non-zero element. A row (column)
+ * that does not fit is split, the rest opens the next panel.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param filename The name of the snapshot file, for the error messages.
+ * @return true if the snapshot is valid, false otherwise.
+ */
+template <class T, StorageOrder storage, class Index>
+bool StreamingSparseMatrix<T,storage,Index>::open(const std::string &filename){
+
+    auto fail= [&](const char *message){
+        std::cerr << message << ", file: " << filename << std::endl;
+        return false;
+    };
+
+    struct stat st;
+    if(::fstat(m_fd, &st)!=0 || static_cast<std::uint64_t>(st.st_size)<sizeof(m_header))
+        return fail("File too short for a snapshot");
+    if(!readAt(&m_header, sizeof(m_header), 0))
+        return fail("Failed to read the snapshot header");
+    if(const char *error= detail::checkSnapshotHeader<T,storage,Index>(m_header, st.st_size))
+        return fail(error);
+    ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const std::uint64_t n= IsRowWise<storage>::value ? m_header.rows : m_header.cols;
+    const std::uint64_t limit= m_budget/2;
+    const std::uint64_t per_nnz= sizeof(Index)+sizeof(T);
+    //bytes of the panel that starts at {a, j0} and holds the entries a..last of m_inner and the elements up to nnz_end
+    std::uint64_t a=0, j0=0;
+    auto bytes= [&](std::uint64_t last, std::uint64_t nnz_end){ return (last-a+1)*sizeof(Index) + (nnz_end-j0)*per_nnz; };
+    auto cut= [&](std::uint64_t inner, std::uint64_t nnz){
+        m_panel_bytes= std::max<std::size_t>(m_panel_bytes, bytes(inner, nnz));
+        m_cuts.push_back({inner, nnz});
+        a= inner;
+        j0= nnz;
+    };
+
+    m_cuts.assign(1, {0, 0});
+    //chunks of m_inner, read within the memory budget; chunk[0] is the last entry of the previous chunk
+    std::vector<Index> chunk(std::min<std::uint64_t>(limit/sizeof(Index), n+1));
+    std::uint64_t pos= 0;
+    Index first;
+    if(!readAt(&first, sizeof(Index), m_header.inner_offset) || first!=0)
+        return fail("Corrupted snapshot");
+    chunk[0]= first;
+    for(std::uint64_t r=0; r<n; ){
+        std::uint64_t count= std::min<std::uint64_t>(chunk.size()-1, n-r);
+        if(!readAt(chunk.data()+1, count*sizeof(Index), m_header.inner_offset+(r+1)*sizeof(Index)))
+            return fail("Failed to read the snapshot");
+        for(std::uint64_t k=0; k<count; ++k, ++r){
+            std::uint64_t end= chunk[k+1];
+            if(end<chunk[k] || end>m_header.nnz)
+                return fail("Corrupted snapshot");
+            //row r does not fit: the elements that fit close the panel, the rest of the row opens the next one
+            while(bytes(r+1, end)>limit){
+                std::uint64_t start= std::max(pos, j0);
+                cut(r, start + std::min<std::uint64_t>((limit-bytes(r, start))/per_nnz, end-start));
+            }
+            pos= end;
+        }
+        chunk[0]= chunk[count];
+    }
+    if(pos!=m_header.nnz)
+        return fail("Corrupted snapshot");
+    cut(n, m_header.nnz);
+    return true;
+};
+
+/**
+ * @brief Reads bytes at an offset of the file, repeating the read until all the bytes arrive.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param buffer The destination.
+ * @param bytes The number of bytes.
+ * @param offset The offset in the file.
+ * @return true if all the bytes were read, false otherwise.
+ */
+template <class T, StorageOrder storage, class Index>
+bool StreamingSparseMatrix<T,storage,Index>::readAt(void *buffer, std::size_t bytes, std::uint64_t offset) const {
+    char *p= static_cast<char*>(buffer);
+    while(bytes>0){
+        ssize_t n= ::pread(m_fd, p, bytes, offset);
+        if(n<=0)
+            return false;
+        p+= n;
+        bytes-= n;
+        offset+= n;
+    }
+    return true;
+};
+
+/**
+ * @brief Reads the slice of m_inner and the ranges of m_outer and m_values of a panel.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @param p The panel.
+ * @param panel The buffers.
+ * @return true if the panel was read, false otherwise.
+ */
+template <class T, StorageOrder storage, class Index>
+bool StreamingSparseMatrix<T,storage,Index>::readPanel(std::size_t p, Panel &panel) const {
+    const Cut &begin= m_cuts[p], &end= m_cuts[p+1];
+    std::size_t n_inner= end.inner-begin.inner+1, n_nnz= end.nnz-begin.nnz;
+    //the values follow the indexes, at the first position aligned for T
+    std::size_t values_position= ((n_inner+n_nnz)*sizeof(Index) + alignof(T)-1)/alignof(T)*alignof(T);
+    Index *inner= reinterpret_cast<Index*>(panel.buffer.get());
+    Index *outer= inner+n_inner;
+    T *values= reinterpret_cast<T*>(panel.buffer.get()+values_position);
+    panel.inner= inner;
+    panel.outer= outer;
+    panel.values= values;
+    return readAt(inner, n_inner*sizeof(Index), m_header.inner_offset + begin.inner*sizeof(Index))
+        && readAt(outer, n_nnz*sizeof(Index), m_header.outer_offset + begin.nnz*sizeof(Index))
+        && readAt(values, n_nnz*sizeof(T), m_header.values_offset + begin.nnz*sizeof(T));
+};
+
+/**
+ * @brief Checks the checksum of the arrays, reading them in chunks of half of the memory budget.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the matrix (row-wise or column-wise).
+ * @tparam Index The type of the stored indexes.
+ * @return true if the checksum is right, false otherwise.
+ */
+template <class T, StorageOrder storage, class Index>
+bool StreamingSparseMatrix<T,storage,Index>::verify() const {
+    if(!is_open())
+        return false;
+    std::uint64_t n_inner= (IsRowWise<storage>::value ? m_header.rows : m_header.cols) + 1;
+    std::vector<char> buffer(m_budget/2);
+    std::uint64_t hash= 0xcbf29ce484222325ull;
+    auto hash_range= [&](std::uint64_t offset, std::uint64_t size){
+        while(size>0){
+            std::size_t n= std::min<std::uint64_t>(size, buffer.size());
+            if(!readAt(buffer.data(), n, offset))
+                return false;
+            hash= detail::fnv1a(buffer.data(), n, hash);
+            offset+= n;
+            size-= n;
+        }
+        return true;
+    };
+    if(!hash_range(m_header.inner_offset, n_inner*sizeof(Index)) || !hash_range(m_header.outer_offset, m_header.nnz*sizeof(Index))
+       || !hash_range(m_header.values_offset, m_header.nnz*sizeof(T))){
+        std::cerr << "Failed to read the snapshot\n";
+        return false;
+    }
+    return hash==m_header.checksum;
+};
+
+/**
+ * @brief Performs y = alpha*A*x + beta*y, or y = alpha*A^T*x + beta*y, reading A from disk panel by panel.
+ *
+ * y is scaled by beta, then the panels are multiplied in order; while panel p is multiplied, panel p+1 is read
+ * by another thread into the second buffer. A CSR panel (or a CSC one, for the transpose) gathers: every row
+ * accumulates its dot product with x; the other two cases scatter into y. A row split between two panels
+ * accumulates twice.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @param alpha The factor of the product.
+ * @param m The streaming sparse matrix.
+ * @param x The input vector, of size m.cols() (m.rows() for the transpose).
+ * @param beta The factor of y.
+ * @param y The output vector, of size m.rows() (m.cols() for the transpose).
+ * @param transpose true for multiplying by the transpose of the matrix.
+ * @return true if the whole matrix was read, false otherwise.
+ */
+template <class U, StorageOrder s, class I>
+bool gemv(std::type_identity_t<U> alpha, const StreamingSparseMatrix<U,s,I> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose){
+
+    std::size_t n_in= transpose ? m.rows() : m.cols();
+    std::size_t n_out= transpose ? m.cols() : m.rows();
+    if(!m.is_open() || x.size()!=n_in || y.size()!=n_out){
+        std::cerr << "Dimensions are incompatible\n";
+        return false;
+    }
+    detail::scaleVector(beta, y, n_out);
+    if(m.panels()==0)
+        return true;
+
+    using Panel= typename StreamingSparseMatrix<U,s,I>::Panel;
+    Panel buffers[2];
+    for(auto &b: buffers)
+        b.buffer.reset(new char[m.m_panel_bytes + alignof(U)]);
+    const bool gather= IsRowWise<s>::value != transpose;
+
+    bool ok= m.readPanel(0, buffers[0]);
+    for(std::size_t p=0; ok && p<m.panels(); ++p){
+        //prefetch of the next panel
+        std::future<bool> next;
+        if(p+1<m.panels())
+            next= std::async(std::launch::async, [&m, &buffers, p](){ return m.readPanel(p+1, buffers[(p+1)%2]); });
+
+        const Panel &panel= buffers[p%2];
+        const std::uint64_t a= m.m_cuts[p].inner, j0= m.m_cuts[p].nnz, j1= m.m_cuts[p+1].nnz;
+        const std::uint64_t n_inner= m.m_cuts[p+1].inner-a+1;
+        for(std::uint64_t k=0; k<n_inner; ++k){
+            std::uint64_t start= std::max<std::uint64_t>(panel.inner[k], j0);
+            std::uint64_t end= k+1<n_inner ? std::min<std::uint64_t>(panel.inner[k+1], j1) : j1;
+            if(start>=end)
+                continue;
+            if(gather){
+                U sum= U();
+                for(std::uint64_t j=start; j<end; ++j)
+                    sum+= panel.values[j-j0]*x[panel.outer[j-j0]];
+                y[a+k]+= alpha*sum;
+            }
+            else{
+                const U xk= alpha*x[a+k];
+                for(std::uint64_t j=start; j<end; ++j)
+                    y[panel.outer[j-j0]]+= panel.values[j-j0]*xk;
+            }
+        }
+        if(next.valid())
+            ok= next.get();
+    }
+    if(!ok)
+        std::cerr << "Failed to read the snapshot\n";
+    return ok;
+};
+
+/**
+ * @brief Performs the product between the streaming matrix and a vector, through gemv.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @param m The streaming sparse matrix.
+ * @param v The vector.
+ * @return The resulting vector, empty if the dimensions are incompatible or a read failed.
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const StreamingSparseMatrix<U,s,I> &m, const std::vector<U> &v){
+    std::vector<U> res(m.rows());
+    if(!gemv(U(1), m, v, U(0), res))
+        return std::vector<U>();
+    return res;
+};
+
+};
+
+
+#endif /*STREAMINGSPARSEMATRIX_HPP*/
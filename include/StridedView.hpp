@@ -0,0 +1,89 @@
+#ifndef STRIDEDVIEW_HPP
+#define STRIDEDVIEW_HPP
+
+/**
+ * \file StridedView.hpp
+ * \brief Non-owning view of equally spaced elements of a buffer
+ */
+
+// clang-format off
+#include <concepts>
+#include <cstddef>
+#include <span>
+
+namespace algebra{
+
+/**
+ * \brief Non-owning view of size elements, stride elements apart, e.g. a column of a row-major dense matrix
+ *
+ * It is implicitly built from anything std::span can be built from (std::vector, std::array, std::span...), with
+ * stride 1, so that functions taking a StridedView accept the usual containers without copies.
+ *
+ * \tparam T Type of the elements, const T for a read-only view
+ */
+template <class T>
+class StridedView{
+
+public:
+
+    /**
+     * \brief Constructor from a pointer
+     * \param data Pointer to the first element
+     * \param size Number of elements
+     * \param stride Distance between two consecutive elements
+     */
+    StridedView(T *data, std::size_t size, std::size_t stride=1): m_data(data), m_size(size), m_stride(stride) {};
+
+    /**
+     * \brief Constructor from a contiguous range, with stride 1
+     * \tparam Range Type of the range, anything convertible to std::span<T>
+     * \param r The range
+     */
+    template <class Range>
+    requires std::constructible_from<std::span<T>, Range&>
+    StridedView(Range &r): StridedView(std::span<T>(r)) {};
+
+    /**
+     * \brief Constructor from a span, with stride 1
+     * \param s The span
+     */
+    StridedView(std::span<T> s): m_data(s.data()), m_size(s.size()), m_stride(1) {};
+
+    /**
+     * \brief Access to the i-th element
+     */
+    T & operator[](std::size_t i) const {return m_data[i*m_stride];};
+
+    /**
+     * \brief Number of elements
+     */
+    std::size_t size() const {return m_size;};
+
+    /**
+     * \brief Distance between two consecutive elements
+     */
+    std::size_t stride() const {return m_stride;};
+
+    /**
+     * \brief Pointer to the first element
+     */
+    T * data() const {return m_data;};
+
+    /**
+     * \brief Check if the elements are contiguous
+     * \return true if the stride is 1 (or there is at most one element)
+     */
+    bool contiguous() const {return m_stride==1 || m_size<=1;};
+
+private:
+
+    T *m_data;
+    std::size_t m_size;
+    std::size_t m_stride;
+
+};
+
+};
+
+
+#endif /*STRIDEDVIEW_HPP*/
@@ -0,0 +1,439 @@
+#ifndef SYMMETRICSPARSEMATRIX_HPP
+#define SYMMETRICSPARSEMATRIX_HPP
+
+/**
+ * \file SymmetricSparseMatrix.hpp
+ * \brief Header file for the SymmetricSparseMatrix class, which stores one triangle of a symmetric matrix
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "readMatrixMarket.hpp"
+#include "threadUtilities.hpp"
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <span>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Class to store a symmetric sparse matrix, keeping only its upper triangle (the elements (i,j) with i<=j)
+ *
+ * The triangle is a compressed SparseMatrix: with row_wise it is the CSR format of the upper triangle, with
+ * column_wise its CSC format, which has the same vectors as the CSR format of the lower triangle. So both
+ * triangles in both formats are covered. Every off-diagonal element is stored once, which nearly halves the memory
+ * and the bytes read by the product; the product applies it to y[i] and to y[j] in the same pass.
+ *
+ * \tparam T Type of the stored element
+ * \tparam storage Storage order of the triangle
+ * \tparam Index Type of the indexes
+ */
+template <class T, StorageOrder storage, class Index = std::size_t>
+class SymmetricSparseMatrix{
+
+public:
+
+    /**
+     * \brief Constructor of an empty matrix
+     * \param n Number of rows and columns
+     */
+    explicit SymmetricSparseMatrix(std::size_t n=0): m_triangle(n, n) {m_triangle.compress();};
+
+    /**
+     * \brief Constructor from a symmetric SparseMatrix, of which only the upper triangle is read
+     * \tparam s Storage order of the SparseMatrix
+     * \tparam A Assembly backend of the SparseMatrix
+     * \param m The square SparseMatrix, the elements below the diagonal are ignored
+     * \note If m is not square, an error is printed and the matrix is empty
+     */
+    template <StorageOrder s, template<class,StorageOrder,class> class A>
+    explicit SymmetricSparseMatrix(const SparseMatrix<T,s,Index,A> &m);
+
+    /**
+     * \brief Fills the matrix from a buffer of triplets, the previous content is discarded
+     * \param triplets The (row, column, value) entries, in any order, every off-diagonal element in either triangle
+     *        (an element listed in both triangles is summed twice)
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \note Repeated entries are summed, entries out of range are skipped
+     */
+    void setFromTriplets(std::span<const Triplet<T>> triplets, std::size_t n_threads=1);
+
+    /**
+     * \brief Conversion to a SparseMatrix with both triangles
+     * \tparam s Storage order of the result
+     * \return The compressed SparseMatrix
+     */
+    template <StorageOrder s = storage>
+    SparseMatrix<T,s,Index> toSparseMatrix() const;
+
+    /**
+     * \brief Constant call operator
+     * \param r The row index
+     * \param c The column index
+     * \return The value at the specified position, the stored (min(r,c), max(r,c)) element
+     */
+    T operator()(std::size_t r, std::size_t c) const {return r<=c ? m_triangle(r, c) : m_triangle(c, r);};
+
+    /**
+     * \brief Number of rows
+     */
+    std::size_t rows() const {return m_triangle.rows();};
+
+    /**
+     * \brief Number of columns
+     */
+    std::size_t cols() const {return m_triangle.cols();};
+
+    /**
+     * \brief The stored upper triangle
+     */
+    const SparseMatrix<T,storage,Index> & triangle() const {return m_triangle;};
+
+    /**
+     * \brief Function that executes the product between a SymmetricSparseMatrix and a vector, with compatible dimensions
+     * \tparam U Type of elements stored inside SymmetricSparseMatrix and std::vector
+     * \tparam s Storage order of the triangle
+     * \tparam I Index type
+     * \param m The SymmetricSparseMatrix object
+     * \param v The vector object
+     * \return The product vector of elements of type U
+     */
+    template <class U, StorageOrder s, class I>
+    friend std::vector<U> operator*(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v);
+
+    /**
+     * \brief Function that executes the product between a SymmetricSparseMatrix and a vector in parallel
+     * \tparam U Type of elements stored inside SymmetricSparseMatrix and std::vector
+     * \tparam s Storage order of the triangle
+     * \tparam I Index type
+     * \param m The SymmetricSparseMatrix object
+     * \param v The vector object
+     * \param n_threads Number of threads, 0 means one per hardware thread
+     * \return The product vector of elements of type U
+     */
+    template <class U, StorageOrder s, class I>
+    friend std::vector<U> parallelProduct(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v, std::size_t n_threads);
+
+private:
+
+    /**
+     * \brief Fills the triangle with the upper elements of a compressed SparseMatrix
+     */
+    template <StorageOrder s, template<class,StorageOrder,class> class A>
+    void assignUpper(const SparseMatrix<T,s,Index,A> &m);
+
+    /**
+     * \brief The upper triangle, compressed and without pending insertions
+     */
+    SparseMatrix<T,storage,Index> m_triangle;
+
+};
+
+/**
+ * \brief Function that executes the product between a SymmetricSparseMatrix and a vector, with compatible dimensions
+ * \tparam U Type of elements stored inside SymmetricSparseMatrix and std::vector
+ * \tparam s Storage order of the triangle
+ * \tparam I Index type
+ * \param m The SymmetricSparseMatrix object
+ * \param v The vector object
+ * \return The product vector of elements of type U
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v);
+
+/**
+ * \brief Function that executes the product between a SymmetricSparseMatrix and a vector in parallel, without write
+ *        conflicts
+ * \tparam U Type of elements stored inside SymmetricSparseMatrix and std::vector
+ * \tparam s Storage order of the triangle
+ * \tparam I Index type
+ * \param m The SymmetricSparseMatrix object
+ * \param v The vector object
+ * \param n_threads Number of threads, 0 means one per hardware thread
+ * \return The product vector of elements of type U
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> parallelProduct(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v, std::size_t n_threads=0);
+
+/**
+ * \brief Function to read a symmetric matrix in Matrix Market format, keeping one triangle
+ * \tparam U Type of stored elements, an arithmetic type
+ * \tparam s Storage order of the triangle
+ * \tparam I Index type, std::size_t by default
+ * \param filename Name of file in which the matrix is written
+ * \param n_threads Number of threads, 0 means one per hardware thread
+ * \return The SymmetricSparseMatrix, empty if the file cannot be read or its matrix is not square or skew-symmetric
+ */
+template <class U, StorageOrder s, class I = std::size_t>
+SymmetricSparseMatrix<U,s,I> readSymmetricMatrixMarket(const std::string &filename, std::size_t n_threads=0);
+
+
+/**
+ * @brief Builds the matrix from the upper triangle of a SparseMatrix.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the triangle.
+ * @tparam Index The type of the stored indexes.
+ * @tparam s The storage order of the SparseMatrix.
+ * @tparam A The assembly backend of the SparseMatrix.
+ * @param m The square sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ */
+template <class T, StorageOrder storage, class Index>
+template <StorageOrder s, template<class,StorageOrder,class> class A>
+SymmetricSparseMatrix<T,storage,Index>::SymmetricSparseMatrix(const SparseMatrix<T,s,Index,A> &m): m_triangle(0, 0){
+    if(m.rows()!=m.cols()){
+        std::cerr << "Only a square matrix can be symmetric\n";
+        m_triangle.compress();
+        return;
+    }
+    if(!m.is_compressed() || m.pending()){
+        SparseMatrix<T,s,Index,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()){ //too many elements for the index type
+            m_triangle.compress();
+            return;
+        }
+        assignUpper(copy);
+    }
+    else
+        assignUpper(m);
+};
+
+/**
+ * @brief Fills the triangle with the elements of a compressed SparseMatrix on and above the diagonal.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the triangle.
+ * @tparam Index The type of the stored indexes.
+ * @tparam s The storage order of the SparseMatrix.
+ * @tparam A The assembly backend of the SparseMatrix.
+ * @param m The compressed square sparse matrix.
+ */
+template <class T, StorageOrder storage, class Index>
+template <StorageOrder s, template<class,StorageOrder,class> class A>
+void SymmetricSparseMatrix<T,storage,Index>::assignUpper(const SparseMatrix<T,s,Index,A> &m){
+    std::span<const Index> inner= m.inner(), outer= m.outer();
+    std::span<const T> values= m.values();
+    std::vector<Triplet<T>> triplets;
+    for(std::size_t i=0; i+1<inner.size(); ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j){
+            std::size_t r= IsRowWise<s>::value ? i : outer[j];
+            std::size_t c= IsRowWise<s>::value ? outer[j] : i;
+            if(r<=c)
+                triplets.push_back({r, c, values[j]});
+        }
+    m_triangle.resize(m.rows(), m.cols());
+    m_triangle.setFromTriplets(std::span<const Triplet<T>>(triplets));
+};
+
+/**
+ * @brief Fills the upper triangle from triplets of either triangle.
+ *
+ * The entries below the diagonal are moved to the symmetric position, then the triangle is assembled by
+ * SparseMatrix::setFromTriplets.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the triangle.
+ * @tparam Index The type of the stored indexes.
+ * @param triplets The (row, column, value) entries.
+ * @param n_threads The number of threads, 0 means one per hardware thread.
+ */
+template <class T, StorageOrder storage, class Index>
+void SymmetricSparseMatrix<T,storage,Index>::setFromTriplets(std::span<const Triplet<T>> triplets, std::size_t n_threads){
+    std::vector<Triplet<T>> upper(triplets.begin(), triplets.end());
+    for(auto &t: upper)
+        if(t.row>t.col)
+            std::swap(t.row, t.col);
+    m_triangle.setFromTriplets(std::span<const Triplet<T>>(upper), std::plus<T>(), n_threads);
+};
+
+/**
+ * @brief Builds the SparseMatrix with both triangles.
+ *
+ * @tparam T The type of the matrix elements.
+ * @tparam storage The storage order of the triangle.
+ * @tparam Index The type of the stored indexes.
+ * @tparam s The storage order of the result.
+ * @return The compressed SparseMatrix.
+ */
+template <class T, StorageOrder storage, class Index>
+template <StorageOrder s>
+SparseMatrix<T,s,Index> SymmetricSparseMatrix<T,storage,Index>::toSparseMatrix() const{
+    std::span<const Index> inner= m_triangle.inner(), outer= m_triangle.outer();
+    std::span<const T> values= m_triangle.values();
+    std::vector<Triplet<T>> triplets;
+    triplets.reserve(2*values.size());
+    for(std::size_t i=0; i+1<inner.size(); ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j){
+            triplets.push_back({i, outer[j], values[j]});
+            if(outer[j]!=i)
+                triplets.push_back({outer[j], i, values[j]});
+        }
+    SparseMatrix<T,s,Index> res(rows(), cols());
+    res.setFromTriplets(std::span<const Triplet<T>>(triplets));
+    return res;
+};
+
+namespace detail{
+
+/**
+ * @brief Fused product of the rows (columns) [first,last) of a stored triangle with a vector.
+ *
+ * Every stored element (k,o) of the CSR (or CSC) vectors contributes a(k,o)*v[o] to out[k] and, off the diagonal,
+ * a(k,o)*v[k] to out[o]: the two contributions of the element and of its mirror, with one read of the element.
+ * The contributions to out[k] are summed in a register.
+ *
+ * @param out The result, or the part of it starting at element offset.
+ * @param offset The first element of the product written in out.
+ */
+template <class U, class I>
+void symmetricRows(std::size_t first, std::size_t last, const I *inner, const I *outer, const U *values,
+                   const U *v, U *out, std::size_t offset=0){
+    for(std::size_t k=first; k<last; ++k){
+        U sum= U();
+        const U v_k= v[k];
+        for(std::size_t j=inner[k]; j<inner[k+1]; ++j){
+            std::size_t o= outer[j];
+            sum+= values[j]*v[o];
+            if(o!=k)
+                out[o-offset]+= values[j]*v_k;
+        }
+        out[k-offset]+= sum;
+    }
+};
+
+}
+
+/**
+ * @brief Performs the product between a symmetric matrix and a vector, with one pass over the stored triangle.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the triangle.
+ * @tparam I The index type.
+ * @param m The symmetric matrix.
+ * @param v The vector.
+ * @return The resulting vector.
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> operator*(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v){
+    if(m.cols()!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    std::vector<U> res(m.rows());
+    const auto &t= m.m_triangle;
+    detail::symmetricRows(0, m.rows(), t.inner().data(), t.outer().data(), t.values().data(), v.data(), res.data());
+    return res;
+};
+
+/**
+ * @brief Performs the product between a symmetric matrix and a vector, in parallel.
+ *
+ * The rows (columns) of the triangle are split in chunks with roughly the same number of stored elements. A chunk
+ * of rows [first,last) of the CSR upper triangle writes only the elements [first,rows()) of the product, a chunk of
+ * columns of the CSC upper triangle (the rows of the lower one) only the elements [0,last). The first chunk writes
+ * directly into the result, every other chunk into its own buffer of that range, so that no two threads write the
+ * same element. The buffers are then added to the result, every thread summing its own rows.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the triangle.
+ * @tparam I The index type.
+ * @param m The symmetric matrix.
+ * @param v The vector.
+ * @param n_threads Number of threads, 0 uses one per hardware thread.
+ * @return The resulting vector.
+ * @note The buffers need less than (n_threads-1)*rows additional elements of memory.
+ */
+template <class U, StorageOrder s, class I>
+std::vector<U> parallelProduct(const SymmetricSparseMatrix<U,s,I> &m, const std::vector<U> &v, std::size_t n_threads){
+    if(m.cols()!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    const auto &t= m.m_triangle;
+    std::size_t n= m.rows();
+    n_threads= detail::threadCount(n_threads);
+    std::vector<U> res(n);
+    std::vector<std::size_t> bounds= detail::partitionByNnz(t.inner(), n_threads);
+
+    //range [low,high) of the product written by the chunk [first,last)
+    auto range= [n](std::size_t first, std::size_t last){
+        return IsRowWise<s>::value ? std::pair(first, n) : std::pair(std::size_t(0), last);
+    };
+    std::vector<std::vector<U>> partial(n_threads-1);
+    detail::runChunks(bounds, [&](std::size_t p, std::size_t first, std::size_t last){
+        if(p==0){
+            detail::symmetricRows(first, last, t.inner().data(), t.outer().data(), t.values().data(), v.data(), res.data());
+            return;
+        }
+        auto [low, high]= range(first, last);
+        partial[p-1].assign(high-low, U());
+        detail::symmetricRows(first, last, t.inner().data(), t.outer().data(), t.values().data(), v.data(), partial[p-1].data(), low);
+    });
+
+    //reduction of the buffers, every thread sums its own rows
+    if(!partial.empty())
+        detail::runChunks(detail::partitionEvenly(n, n_threads), [&](std::size_t, std::size_t first, std::size_t last){
+            for(std::size_t p=1; p<n_threads; ++p){
+                auto [low, high]= range(bounds[p], bounds[p+1]);
+                for(std::size_t i=std::max(first, low); i<std::min(last, high); ++i)
+                    res[i]+= partial[p-1][i-low];
+            }
+        });
+    return res;
+};
+
+/**
+ * @brief Reads a symmetric matrix in Matrix Market coordinate format, keeping the upper triangle.
+ *
+ * The file is parsed in parallel by detail::parseMarketFile. The entries of a symmetric (or hermitian, for a real
+ * type) file are moved to the upper triangle, those of a general file below the diagonal are dropped, without
+ * checking that they mirror the upper ones; the full matrix is never built.
+ *
+ * @tparam U The type of the stored elements, an arithmetic type.
+ * @tparam s The storage order of the triangle.
+ * @tparam I The index type.
+ * @param filename The name of the file to read.
+ * @param n_threads Number of threads, 0 means one per hardware thread.
+ * @return The symmetric matrix, empty if the file cannot be read or its matrix is not square or skew-symmetric.
+ */
+template <class U, StorageOrder s, class I>
+SymmetricSparseMatrix<U,s,I> readSymmetricMatrixMarket(const std::string &filename, std::size_t n_threads){
+    static_assert(std::is_arithmetic_v<U>, "readSymmetricMatrixMarket parses arithmetic types only");
+
+    detail::MarketEntries<U> entries;
+    if(!detail::parseMarketFile<U>(filename, n_threads, [](std::vector<Triplet<U>> &chunk, MarketSymmetry symmetry){
+            if(symmetry==MarketSymmetry::general)
+                std::erase_if(chunk, [](const Triplet<U> &t){ return t.row>t.col; });
+            else
+                for(auto &t: chunk)
+                    if(t.row>t.col)
+                        std::swap(t.row, t.col);
+        }, entries))
+        return SymmetricSparseMatrix<U,s,I>();
+    if(entries.rows!=entries.cols || entries.symmetry==MarketSymmetry::skew_symmetric){
+        std::cerr << "The matrix is not symmetric, file: " << filename << std::endl;
+        return SymmetricSparseMatrix<U,s,I>();
+    }
+
+    std::vector<Triplet<U>> triplets;
+    for(const auto &chunk: entries.chunks)
+        triplets.insert(triplets.end(), chunk.begin(), chunk.end());
+    if(!fitsIndex<I>(entries.rows, entries.cols, triplets.size())){
+        std::cerr << "The matrix does not fit in the index type, file: " << filename << std::endl;
+        return SymmetricSparseMatrix<U,s,I>();
+    }
+    SymmetricSparseMatrix<U,s,I> m(entries.rows);
+    m.setFromTriplets(triplets, n_threads);
+    return m;
+};
+
+};
+
+
+#endif /*SYMMETRICSPARSEMATRIX_HPP*/
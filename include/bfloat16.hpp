@@ -0,0 +1,67 @@
+#ifndef BFLOAT16_HPP
+#define BFLOAT16_HPP
+
+/**
+ * \file bfloat16.hpp
+ * \brief Storage type of 16 bits with the exponent of float, for the values of low-precision matrices
+ */
+
+// clang-format off
+#include <bit>
+#include <cstdint>
+
+namespace algebra{
+
+/**
+ * \brief Brain floating point number: the 16 most significant bits of a float
+ *
+ * It has the range of float with 8 bits of mantissa (about 3 decimal digits), so it halves the memory of float
+ * values, and a conversion to float is a shift. It is meant for storing the values of a matrix that are multiplied
+ * in a wider type (see castValues and the mixed-precision operator*): the arithmetic goes through the implicit
+ * conversion to float.
+ */
+struct bfloat16{
+
+    /**
+     * \brief Zero
+     */
+    constexpr bfloat16() = default;
+
+    /**
+     * \brief Conversion from float, rounded to the nearest with ties to even, NaN stays NaN
+     * \param f The value
+     */
+    constexpr bfloat16(float f): bits(round(std::bit_cast<std::uint32_t>(f))) {};
+
+    /**
+     * \brief Exact conversion to float
+     */
+    constexpr operator float() const {return std::bit_cast<float>(static_cast<std::uint32_t>(bits)<<16);};
+
+    /**
+     * \brief Builds a bfloat16 from its bits
+     * \param b The bits: sign, 8 of exponent, 7 of mantissa
+     */
+    static constexpr bfloat16 fromBits(std::uint16_t b) {bfloat16 h; h.bits= b; return h;};
+
+    /**
+     * \brief The bits of the number
+     */
+    std::uint16_t bits= 0;
+
+private:
+
+    static constexpr std::uint16_t round(std::uint32_t u){
+        if((u & 0x7FFFFFFFu) > 0x7F800000u) //NaN, the quiet bit keeps it a NaN after the truncation
+            return static_cast<std::uint16_t>((u>>16) | 0x0040u);
+        return static_cast<std::uint16_t>((u + 0x7FFFu + ((u>>16) & 1u))>>16);
+    };
+
+};
+
+static_assert(sizeof(bfloat16)==2, "bfloat16 has to be read as an array of 16-bit integers");
+
+};
+
+
+#endif /*BFLOAT16_HPP*/
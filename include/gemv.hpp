@@ -0,0 +1,211 @@
+#ifndef GEMV_HPP
+#define GEMV_HPP
+
+/**
+ * \file gemv.hpp
+ * \brief In-place matrix-vector product y = alpha*A*x + beta*y (or with the transpose of A)
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "SparseMatrixView.hpp"
+#include "StridedView.hpp"
+#include "simdKernels.hpp"
+#include "instrumentation.hpp"
+#include <type_traits>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief y = beta*y, without reading y if beta is 0
+ * \tparam U Type of the elements
+ * \tparam Y Type of the output, a pointer or a StridedView
+ * \param beta The factor
+ * \param y The vector
+ * \param n The size of y
+ */
+template<class U, class Y>
+void scaleVector(U beta, Y y, std::size_t n){
+    if(beta==U(0))
+        for(std::size_t i=0; i<n; ++i)
+            y[i]= U(0);
+    else if(beta!=U(1))
+        for(std::size_t i=0; i<n; ++i)
+            y[i]*= beta;
+};
+
+/**
+ * \brief y[k] = alpha * sum_j values[j]*x[outer[j]] (+ beta*y[k] if with_beta) for every k, j in [inner[k], inner[k+1])
+ *
+ * The tag selects at compile time whether y is read, so that the loop over the rows has no branches.
+ *
+ * \tparam with_beta true if beta*y[k] is added
+ * \tparam U Type of the elements
+ * \tparam I Type of the indexes
+ * \tparam X Type of the input, a pointer or a StridedView
+ * \tparam Y Type of the output, a pointer or a StridedView
+ */
+template<bool with_beta, class U, class I, class X, class Y>
+void gatherRows(std::bool_constant<with_beta>, std::size_t n, const I *inner, const I *outer, const U *values,
+                U alpha, X x, U beta, Y y){
+    for(std::size_t k=0; k<n; ++k){
+        U sum = U();
+        for(std::size_t j=inner[k]; j<inner[k+1]; ++j)
+            sum += values[j]*x[outer[j]];
+        if constexpr (with_beta)
+            y[k]= alpha*sum + beta*y[k];
+        else
+            y[k]= alpha*sum;
+    }
+};
+
+/**
+ * \brief y[k] = alpha * sum_j values[j]*x[outer[j]] + beta*y[k] for every k, j in [inner[k], inner[k+1])
+ *
+ * This is the CSR product and the CSC product with the transpose. If beta is 0, y is only written.
+ *
+ * \tparam U Type of the elements
+ * \tparam I Type of the indexes
+ * \tparam X Type of the input, a pointer or a StridedView
+ * \tparam Y Type of the output, a pointer or a StridedView
+ */
+template<class U, class I, class X, class Y>
+void gatherProduct(std::size_t n, const I *inner, const I *outer, const U *values,
+                   U alpha, X x, U beta, Y y){
+    if(beta==U(0))
+        gatherRows(std::false_type{}, n, inner, outer, values, alpha, x, beta, y);
+    else
+        gatherRows(std::true_type{}, n, inner, outer, values, alpha, x, beta, y);
+};
+
+/**
+ * \brief y[outer[j]] += alpha*values[j]*x[k] for every k, j in [inner[k], inner[k+1]), after y = beta*y
+ *
+ * This is the CSC product and the CSR product with the transpose.
+ *
+ * \tparam U Type of the elements
+ * \tparam I Type of the indexes
+ * \tparam X Type of the input, a pointer or a StridedView
+ * \tparam Y Type of the output, a pointer or a StridedView
+ */
+template<class U, class I, class X, class Y>
+void scatterProduct(std::size_t n, std::size_t n_out, const I *inner, const I *outer, const U *values,
+                    U alpha, X x, U beta, Y y){
+    scaleVector(beta, y, n_out);
+    for(std::size_t k=0; k<n; ++k){
+        const U ax= alpha*x[k];
+        for(std::size_t j=inner[k]; j<inner[k+1]; ++j)
+            y[outer[j]]+= values[j]*ax;
+    }
+};
+
+}
+
+/**
+ * @brief Performs y = alpha*A*x + beta*y, or y = alpha*A^T*x + beta*y, without allocating, for a SparseMatrixView.
+ *
+ * The CSR product and the CSC product with the transpose gather along the rows (columns), the other two cases
+ * scatter after scaling y. If beta is 0, y is only written, so it may hold garbage (e.g. NaN).
+ * Contiguous x and y take the fast path: with beta equal to 0, float and double use the SIMD kernels of
+ * simd::csrRows. Views with a stride are handled with the same loops, without copies.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @param alpha The factor of the product.
+ * @param m The sparse matrix view.
+ * @param x The input vector, of size m.cols() (m.rows() for the transpose).
+ * @param beta The factor of y.
+ * @param y The output vector, of size m.rows() (m.cols() for the transpose).
+ * @param transpose true for multiplying by the transpose of the matrix.
+ */
+template<class U, StorageOrder s, class I>
+void gemv(std::type_identity_t<U> alpha, const SparseMatrixView<U,s,I> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose){
+
+    std::size_t n_in= transpose ? m.rows() : m.cols();
+    std::size_t n_out= transpose ? m.cols() : m.rows();
+    if(x.size()!=n_in || y.size()!=n_out){
+        std::cerr << "Dimensions are incompatible\n";
+        return;
+    }
+
+    //an empty view has no inner array
+    std::size_t n_inner= m.inner().empty() ? 0 : m.inner().size()-1;
+    const I *inner= m.inner().data();
+    const I *outer= m.outer().data();
+    const U *values= m.values().data();
+    //CSR without transpose and CSC with transpose run along the inner vector
+    bool gather= (IsRowWise<s>::value != transpose);
+
+    auto product= [&](auto xa, auto ya){
+        if(gather)
+            detail::gatherProduct(n_inner, inner, outer, values, alpha, xa, beta, ya);
+        else
+            detail::scatterProduct(n_inner, n_out, inner, outer, values, alpha, xa, beta, ya);
+    };
+
+    if(x.contiguous() && y.contiguous()){
+        if constexpr (simd::hasKernel<U,I>)
+            if(gather && beta==U(0)){
+                simd::csrRows(0, n_inner, inner, outer, values, x.data(), y.data());
+                detail::scaleVector(alpha, y.data(), n_out);
+                return;
+            }
+        product(x.data(), y.data());
+    }
+    else
+        product(x, y);
+};
+
+/**
+ * @brief Performs y = alpha*A*x + beta*y, or y = alpha*A^T*x + beta*y, without allocating.
+ *
+ * Compressed matrices use the kernels of the SparseMatrixView version, then the pending insertions are added.
+ * Uncompressed matrices loop over the map.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param alpha The factor of the product.
+ * @param m The sparse matrix.
+ * @param x The input vector, of size m.cols() (m.rows() for the transpose).
+ * @param beta The factor of y.
+ * @param y The output vector, of size m.rows() (m.cols() for the transpose).
+ * @param transpose true for multiplying by the transpose of the matrix.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+void gemv(std::type_identity_t<U> alpha, const SparseMatrix<U,s,I,A> &m, StridedView<const std::type_identity_t<U>> x,
+          std::type_identity_t<U> beta, StridedView<std::type_identity_t<U>> y, bool transpose){
+
+    std::size_t n_in= transpose ? m.m_rows : m.m_cols;
+    std::size_t n_out= transpose ? m.m_cols : m.m_rows;
+    if(x.size()!=n_in || y.size()!=n_out){
+        std::cerr << "Dimensions are incompatible\n";
+        return;
+    }
+    ALGEBRA_TIME(gemv);
+    [[maybe_unused]] std::size_t nnz= m.m_compressed ? m.m_values.size()+m.m_pending.size() : m.m_data_uncompressed.size();
+    ALGEBRA_VOLUME(gemv, nnz*(sizeof(I)+sizeof(U)) + m.m_inner.size()*sizeof(I) + (n_in+n_out)*sizeof(U), nnz);
+
+    //the row (column) of the result and the element of the input of a key of the map
+    std::size_t out_key= transpose ? 1 : 0;
+
+    if(m.m_compressed){
+        gemv(alpha, SparseMatrixView<U,s,I>(m), x, beta, y, transpose);
+        m.m_pending.forEach([&](const std::array<I,2> &key, const U &value){ y[key[out_key]]+= alpha*value*x[key[!out_key]]; });
+    }
+    else{
+        detail::scaleVector(beta, y, n_out);
+        //loop over non-zero elements of the uncompressed state
+        m.m_data_uncompressed.forEach([&](const std::array<I,2> &key, const U &value){ y[key[out_key]]+= alpha*value*x[key[!out_key]]; });
+    }
+};
+
+};
+
+
+#endif /*GEMV_HPP*/
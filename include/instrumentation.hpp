@@ -0,0 +1,296 @@
+#ifndef INSTRUMENTATION_HPP
+#define INSTRUMENTATION_HPP
+
+/**
+ * \file instrumentation.hpp
+ * \brief Optional counters and timers of the SparseMatrix operations, enabled by defining ALGEBRA_INSTRUMENTATION
+ */
+
+// clang-format off
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace algebra{
+
+namespace instrumentation{
+
+/**
+ * \brief true if the library was compiled with ALGEBRA_INSTRUMENTATION, otherwise the hooks expand to nothing
+ *        and every report is empty
+ */
+#ifdef ALGEBRA_INSTRUMENTATION
+inline constexpr bool enabled= true;
+#else
+inline constexpr bool enabled= false;
+#endif
+
+/**
+ * \brief Instrumented operations
+ *
+ * The timed ones count calls and time; assemblyAccess, compressedAccess and insertCompressed only count calls,
+ * being too short to be timed. toCompressed, toUncompressed and resizeUncompress count the changes of state,
+ * the last one when resize() uncompresses a compressed matrix.
+ */
+enum class Operation : std::size_t{
+    compress, uncompress, finalize, setFromTriplets, resize,
+    insertCompressed, assemblyAccess, compressedAccess,
+    product, gemv, parallelProduct, multiply, sparseProduct,
+    readMatrixMarket, readMatrixMarketMapped,
+    toCompressed, toUncompressed, resizeUncompress,
+    count
+};
+
+inline constexpr std::size_t n_operations= static_cast<std::size_t>(Operation::count);
+
+/**
+ * \brief Name of an operation, as in the JSON export
+ */
+inline const char * operationName(Operation operation){
+    static constexpr const char *names[n_operations]= {
+        "compress", "uncompress", "finalize", "setFromTriplets", "resize",
+        "insertCompressed", "assemblyAccess", "compressedAccess",
+        "product", "gemv", "parallelProduct", "multiply", "sparseProduct",
+        "readMatrixMarket", "readMatrixMarketMapped",
+        "toCompressed", "toUncompressed", "resizeUncompress"
+    };
+    return names[static_cast<std::size_t>(operation)];
+};
+
+/**
+ * \brief Totals of an operation
+ *
+ * bytes are the bytes of the arrays read or written at least once, elements the non-zero elements handled:
+ * for finalize(), the stored elements shifted to make room for the pending insertions.
+ */
+struct Totals{
+    std::uint64_t calls=0;
+    std::uint64_t nanoseconds=0;
+    std::uint64_t bytes=0;
+    std::uint64_t elements=0;
+};
+
+/**
+ * \brief Totals of all the threads, taken by snapshot()
+ */
+struct Report{
+
+    std::array<Totals, n_operations> operations{};
+
+    /**
+     * \brief Number of threads that recorded, the live ones and the ended ones
+     */
+    std::size_t threads=0;
+
+    const Totals & operator[](Operation operation) const {return operations[static_cast<std::size_t>(operation)];};
+
+    /**
+     * \brief JSON object with one member per operation: calls, seconds, bytes and elements
+     */
+    std::string toJson() const{
+        std::string json= "{\n  \"enabled\": " + std::string(enabled ? "true" : "false") + ",\n  \"threads\": "
+                          + std::to_string(threads) + ",\n  \"operations\": {\n";
+        for(std::size_t k=0; k<n_operations; ++k){
+            const Totals &t= operations[k];
+            char line[256];
+            std::snprintf(line, sizeof(line), "    \"%s\": {\"calls\": %llu, \"seconds\": %.9f, \"bytes\": %llu, \"elements\": %llu}%s\n",
+                          operationName(static_cast<Operation>(k)), static_cast<unsigned long long>(t.calls), t.nanoseconds*1e-9,
+                          static_cast<unsigned long long>(t.bytes), static_cast<unsigned long long>(t.elements),
+                          k+1<n_operations ? "," : "");
+            json+= line;
+        }
+        return json + "  }\n}\n";
+    };
+
+};
+
+namespace detail{
+
+/**
+ * \brief Counters of one thread, written only by it without atomic read-modify-write, read by snapshot()
+ */
+struct ThreadCounters{
+
+    std::array<std::array<std::atomic<std::uint64_t>, 4>, n_operations> values{};
+
+    ThreadCounters();
+    ~ThreadCounters();
+
+    void add(Operation operation, std::size_t field, std::uint64_t value){
+        auto &counter= values[static_cast<std::size_t>(operation)][field];
+        counter.store(counter.load(std::memory_order_relaxed)+value, std::memory_order_relaxed);
+    };
+
+    void addTo(std::array<Totals, n_operations> &totals) const{
+        for(std::size_t k=0; k<n_operations; ++k){
+            totals[k].calls+= values[k][0].load(std::memory_order_relaxed);
+            totals[k].nanoseconds+= values[k][1].load(std::memory_order_relaxed);
+            totals[k].bytes+= values[k][2].load(std::memory_order_relaxed);
+            totals[k].elements+= values[k][3].load(std::memory_order_relaxed);
+        }
+    };
+
+};
+
+/**
+ * \brief Counters of the live threads and totals of the ended ones
+ */
+struct Registry{
+
+    std::mutex mutex;
+    std::vector<ThreadCounters*> live;
+    std::array<Totals, n_operations> ended{};
+    std::size_t ended_threads=0;
+
+    static Registry & instance(){
+        static Registry registry;
+        return registry;
+    };
+
+};
+
+inline ThreadCounters::ThreadCounters(){
+    Registry &registry= Registry::instance();
+    std::lock_guard lock(registry.mutex);
+    registry.live.push_back(this);
+};
+
+//the totals of an ending thread are kept
+inline ThreadCounters::~ThreadCounters(){
+    Registry &registry= Registry::instance();
+    std::lock_guard lock(registry.mutex);
+    addTo(registry.ended);
+    ++registry.ended_threads;
+    std::erase(registry.live, this);
+};
+
+/**
+ * \brief Counters of the calling thread, registered at its first use
+ */
+inline ThreadCounters & localCounters(){
+    thread_local ThreadCounters counters;
+    return counters;
+};
+
+}
+
+/**
+ * \brief Counts a call of an operation
+ */
+inline void count(Operation operation){
+    detail::localCounters().add(operation, 0, 1);
+};
+
+/**
+ * \brief Adds bytes and elements to an operation
+ */
+inline void addVolume(Operation operation, std::uint64_t bytes, std::uint64_t elements){
+    detail::ThreadCounters &counters= detail::localCounters();
+    counters.add(operation, 2, bytes);
+    counters.add(operation, 3, elements);
+};
+
+/**
+ * \brief Counts a call of an operation and adds the time until the end of the scope
+ */
+class ScopedTimer{
+
+public:
+
+    explicit ScopedTimer(Operation operation): m_operation(operation), m_start(std::chrono::steady_clock::now()) {};
+
+    ScopedTimer(const ScopedTimer &)= delete;
+    ScopedTimer & operator=(const ScopedTimer &)= delete;
+
+    ~ScopedTimer(){
+        auto elapsed= std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-m_start);
+        detail::ThreadCounters &counters= detail::localCounters();
+        counters.add(m_operation, 0, 1);
+        counters.add(m_operation, 1, elapsed.count());
+    };
+
+private:
+
+    Operation m_operation;
+    std::chrono::steady_clock::time_point m_start;
+
+};
+
+/**
+ * \brief Sums the counters of all the threads
+ * \note The counters of the threads still recording are read while they change, so that their totals may miss
+ *       the last operations
+ */
+inline Report snapshot(){
+    Report report;
+    if constexpr (!enabled)
+        return report;
+    detail::Registry &registry= detail::Registry::instance();
+    std::lock_guard lock(registry.mutex);
+    report.operations= registry.ended;
+    for(const detail::ThreadCounters *counters: registry.live)
+        counters->addTo(report.operations);
+    report.threads= registry.ended_threads + registry.live.size();
+    return report;
+};
+
+/**
+ * \brief Sets all the counters to zero
+ * \note To be called while no thread is recording, otherwise some of its counts may survive
+ */
+inline void reset(){
+    detail::Registry &registry= detail::Registry::instance();
+    std::lock_guard lock(registry.mutex);
+    registry.ended= {};
+    registry.ended_threads= 0;
+    for(detail::ThreadCounters *counters: registry.live)
+        for(auto &operation: counters->values)
+            for(auto &value: operation)
+                value.store(0, std::memory_order_relaxed);
+};
+
+/**
+ * \brief Writes snapshot().toJson() in a file
+ * \param filename Name of the file
+ * \return true if the file was written, false (and an error is printed) otherwise
+ */
+inline bool writeJson(const std::string &filename){
+    std::FILE *file= std::fopen(filename.c_str(), "w");
+    if(!file){
+        std::fprintf(stderr, "Failed to open file: %s\n", filename.c_str());
+        return false;
+    }
+    std::string json= snapshot().toJson();
+    bool written= std::fwrite(json.data(), 1, json.size(), file)==json.size();
+    return std::fclose(file)==0 && written;
+};
+
+}
+
+};
+
+/**
+ * \brief Hooks of the library: ALGEBRA_TIME times the enclosing scope, ALGEBRA_COUNT counts a call,
+ *        ALGEBRA_VOLUME adds bytes and elements. Without ALGEBRA_INSTRUMENTATION they expand to nothing and
+ *        their arguments are not evaluated
+ */
+#ifdef ALGEBRA_INSTRUMENTATION
+#define ALGEBRA_TIME(operation) \
+    ::algebra::instrumentation::ScopedTimer algebra_scoped_timer(::algebra::instrumentation::Operation::operation)
+#define ALGEBRA_COUNT(operation) \
+    ::algebra::instrumentation::count(::algebra::instrumentation::Operation::operation)
+#define ALGEBRA_VOLUME(operation, bytes, elements) \
+    ::algebra::instrumentation::addVolume(::algebra::instrumentation::Operation::operation, (bytes), (elements))
+#else
+#define ALGEBRA_TIME(operation) ((void)0)
+#define ALGEBRA_COUNT(operation) ((void)0)
+#define ALGEBRA_VOLUME(operation, bytes, elements) ((void)0)
+#endif
+
+
+#endif /*INSTRUMENTATION_HPP*/
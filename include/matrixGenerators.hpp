@@ -0,0 +1,167 @@
+#ifndef MATRIXGENERATORS_HPP
+#define MATRIXGENERATORS_HPP
+
+/**
+ * \file matrixGenerators.hpp
+ * \brief Generators of synthetic sparse matrices, as triplets, for benchmarks and tests
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Sparse matrix as a list of entries, to be assembled with SparseMatrix::setFromTriplets
+ * \tparam T Type of the stored element
+ * \note The triplets may repeat a position, setFromTriplets merges them
+ */
+template <class T>
+struct TripletMatrix{
+    std::size_t rows=0, cols=0;
+    std::vector<Triplet<T>> triplets;
+};
+
+/**
+ * \brief Square banded matrix: row i has the columns from i-half_bandwidth to i+half_bandwidth
+ * \tparam T Type of the stored element
+ * \param n Number of rows and columns
+ * \param half_bandwidth Number of diagonals above (and below) the main one
+ * \return The triplets, in row order, with 2*half_bandwidth+1 at the diagonal and -1 elsewhere
+ */
+template <class T>
+TripletMatrix<T> bandedMatrix(std::size_t n, std::size_t half_bandwidth){
+    TripletMatrix<T> m{n, n, {}};
+    m.triplets.reserve(n*(2*half_bandwidth+1));
+    for(std::size_t i=0; i<n; ++i){
+        std::size_t first= i>half_bandwidth ? i-half_bandwidth : 0;
+        std::size_t last= std::min(n, i+half_bandwidth+1);
+        for(std::size_t j=first; j<last; ++j)
+            m.triplets.push_back({i, j, i==j ? T(2*half_bandwidth+1) : T(-1)});
+    }
+    return m;
+};
+
+/**
+ * \brief Square matrix with the same number of elements per row, in columns drawn uniformly
+ * \tparam T Type of the stored element
+ * \param n Number of rows and columns
+ * \param per_row Number of elements per row, before merging the repeated columns
+ * \param seed Seed of the random generator
+ * \return The triplets, in row order, with values in [0, 1)
+ */
+template <class T>
+TripletMatrix<T> randomUniformMatrix(std::size_t n, std::size_t per_row, std::uint64_t seed=1){
+    TripletMatrix<T> m{n, n, {}};
+    if(n==0)
+        return m;
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<std::size_t> column(0, n-1);
+    std::uniform_real_distribution<double> value(0., 1.);
+    m.triplets.reserve(n*per_row);
+    for(std::size_t i=0; i<n; ++i)
+        for(std::size_t k=0; k<per_row; ++k)
+            m.triplets.push_back({i, column(gen), T(value(gen))});
+    return m;
+};
+
+/**
+ * \brief Square matrix whose row lengths follow a power law (Pareto), as the graphs of web pages or social networks
+ *
+ * Most rows are short and few rows are very long, which unbalances the row-wise products and the threads.
+ *
+ * \tparam T Type of the stored element
+ * \param n Number of rows and columns
+ * \param mean_per_row Mean number of elements per row
+ * \param exponent Exponent of the Pareto distribution, greater than 1: the smaller, the longer the longest rows
+ * \param seed Seed of the random generator
+ * \return The triplets, in row order, with values in [0, 1)
+ */
+template <class T>
+TripletMatrix<T> powerLawMatrix(std::size_t n, double mean_per_row, double exponent=2., std::uint64_t seed=1){
+    TripletMatrix<T> m{n, n, {}};
+    if(n==0 || exponent<=1.)
+        return m;
+    std::mt19937_64 gen(seed);
+    std::uniform_int_distribution<std::size_t> column(0, n-1);
+    std::uniform_real_distribution<double> uniform(0., 1.);
+    //Pareto with mean mean_per_row: x_min*exponent/(exponent-1)
+    const double x_min= mean_per_row*(exponent-1.)/exponent;
+    m.triplets.reserve(static_cast<std::size_t>(n*mean_per_row));
+    for(std::size_t i=0; i<n; ++i){
+        double length= x_min/std::pow(1.-uniform(gen), 1./exponent);
+        std::size_t count= std::min<std::size_t>(n, static_cast<std::size_t>(std::llround(length)));
+        for(std::size_t k=0; k<count; ++k)
+            m.triplets.push_back({i, column(gen), T(uniform(gen))});
+    }
+    return m;
+};
+
+/**
+ * \brief Matrix of the trilinear finite elements (27-point stencil) on a structured grid of nx*ny*nz nodes
+ *
+ * The node (i,j,k) is the row i + nx*(j + ny*k) and it is coupled with the nodes at distance at most one in
+ * every direction. The matrix is symmetric, with 26 at the diagonal and -1 elsewhere.
+ *
+ * \tparam T Type of the stored element
+ * \param nx Number of nodes along x
+ * \param ny Number of nodes along y
+ * \param nz Number of nodes along z
+ * \return The triplets, in row order and sorted inside every row
+ */
+template <class T>
+TripletMatrix<T> femStencilMatrix(std::size_t nx, std::size_t ny, std::size_t nz){
+    std::size_t n= nx*ny*nz;
+    TripletMatrix<T> m{n, n, {}};
+    m.triplets.reserve(27*n);
+    auto range= [](std::size_t i, std::size_t size){
+        return std::pair<std::size_t,std::size_t>(i>0 ? i-1 : 0, std::min(size, i+2));
+    };
+    for(std::size_t k=0; k<nz; ++k)
+        for(std::size_t j=0; j<ny; ++j)
+            for(std::size_t i=0; i<nx; ++i){
+                std::size_t row= i + nx*(j + ny*k);
+                auto [k0, k1]= range(k, nz);
+                auto [j0, j1]= range(j, ny);
+                auto [i0, i1]= range(i, nx);
+                for(std::size_t kk=k0; kk<k1; ++kk)
+                    for(std::size_t jj=j0; jj<j1; ++jj)
+                        for(std::size_t ii=i0; ii<i1; ++ii){
+                            std::size_t col= ii + nx*(jj + ny*kk);
+                            m.triplets.push_back({row, col, row==col ? T(26) : T(-1)});
+                        }
+            }
+    return m;
+};
+
+/**
+ * \brief Renumbers the rows and the columns of a square matrix with the same random permutation
+ *
+ * A structured matrix (e.g. femStencilMatrix) becomes a matrix with the numbering of an unstructured mesh: the same
+ * graph, hence the same reachable bandwidth after a reordering, but the elements of every row scattered.
+ *
+ * \tparam T Type of the stored element
+ * \param m The matrix, renumbered in place
+ * \param seed Seed of the random generator
+ */
+template <class T>
+void shuffleNumbering(TripletMatrix<T> &m, std::uint64_t seed=1){
+    std::vector<std::size_t> numbering(m.rows);
+    for(std::size_t i=0; i<m.rows; ++i)
+        numbering[i]= i;
+    std::shuffle(numbering.begin(), numbering.end(), std::mt19937_64(seed));
+    for(auto &t: m.triplets){
+        t.row= numbering[t.row];
+        t.col= numbering[t.col];
+    }
+};
+
+};
+
+
+#endif /*MATRIXGENERATORS_HPP*/
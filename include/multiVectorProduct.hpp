@@ -0,0 +1,156 @@
+#ifndef MULTIVECTORPRODUCT_HPP
+#define MULTIVECTORPRODUCT_HPP
+
+/**
+ * \file multiVectorProduct.hpp
+ * \brief Product between a SparseMatrix and a dense block of vectors (SpMM)
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <array>
+#include <type_traits>
+#include <vector>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Product of a SparseMatrix with a dense block of k vectors, described by strides
+ *
+ * Element (j,c) of the block is X[j*x_row + c*x_col] and element (i,c) of the result is Y[i*y_row + c*y_col],
+ * so the same kernel handles the row-major (x_col=1) and column-major (x_row=1) layouts.
+ * Every non-zero element of the matrix is loaded once and used for all the k vectors.
+ *
+ * \tparam K Number of vectors known at compile time, 0 if it is known only at runtime
+ * \tparam by_rows true if X and Y are row-major, then x_col and y_col are taken as 1 at compile time
+ * \tparam U Type of the elements
+ * \tparam s Storage order of the SparseMatrix
+ * \tparam I Index type of the SparseMatrix
+ * \tparam A Assembly backend of the SparseMatrix
+ * \param m The compressed SparseMatrix
+ * \param k Number of vectors
+ * \param X The dense block of vectors
+ * \param x_row Distance between two rows of X
+ * \param x_col Distance between two columns of X
+ * \param Y The result, it must be zero-initialized
+ * \param y_row Distance between two rows of Y
+ * \param y_col Distance between two columns of Y
+ */
+template<std::size_t K, bool by_rows, class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+void multiVectorKernel(const SparseMatrix<U,s,I,A> &m, std::size_t k, const U *X, std::size_t x_row, std::size_t x_col,
+                       U *Y, std::size_t y_row, std::size_t y_col){
+    const std::size_t n_vectors= K ? K : k;
+    //contiguous vectors let the compiler vectorize the loops over them
+    if constexpr (by_rows)
+        x_col= y_col= 1;
+    auto inner= m.inner();
+    auto outer= m.outer();
+    auto values= m.values();
+
+    if constexpr (IsRowWise<s>::value){ //CSR, the row of the result is accumulated locally
+        using Accumulator= std::conditional_t<K==0, std::vector<U>, std::array<U, K ? K : 1>>;
+        Accumulator acc{};
+        if constexpr (K==0)
+            acc.resize(n_vectors);
+        for(std::size_t i=0; i+1<inner.size(); ++i){
+            std::fill(acc.begin(), acc.end(), U());
+            for(std::size_t j=inner[i]; j<inner[i+1]; ++j){
+                const U a= values[j];
+                const U *x= X + outer[j]*x_row;
+                for(std::size_t c=0; c<n_vectors; ++c)
+                    acc[c]+= a*x[c*x_col];
+            }
+            for(std::size_t c=0; c<n_vectors; ++c)
+                Y[i*y_row + c*y_col]= acc[c];
+        }
+    }
+    else{ //CSC, every element scatters into a row of the result
+        for(std::size_t j=0; j+1<inner.size(); ++j){
+            const U *x= X + j*x_row;
+            for(std::size_t l=inner[j]; l<inner[j+1]; ++l){
+                const U a= values[l];
+                U *y= Y + outer[l]*y_row;
+                for(std::size_t c=0; c<n_vectors; ++c)
+                    y[c*y_col]+= a*x[c*x_col];
+            }
+        }
+    }
+};
+
+}
+
+/**
+ * @brief Performs the product between a sparse matrix and a dense block of k vectors.
+ *
+ * The block has m.cols() rows and k columns and is stored row by row (row_wise) or column by column
+ * (column_wise); the result has m.rows() rows and k columns, with the same layout.
+ * Compared with k calls of operator*, the matrix is read from memory only once. The kernels are compiled for
+ * k equal to 1, 2, 4, 8, 16, 32 and 64, with loops of fixed length; other values use a generic kernel.
+ * The row_wise layout gives contiguous accesses to the vectors and is the faster one.
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix.
+ * @param X The dense block of vectors.
+ * @param k The number of vectors.
+ * @param layout The layout of X and of the result.
+ * @return The dense block of the products.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> multiply(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &X, std::size_t k, StorageOrder layout){
+
+    if(X.size()!=m.m_cols*k){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    ALGEBRA_TIME(multiply);
+    [[maybe_unused]] std::size_t nnz= m.m_compressed ? m.m_values.size()+m.m_pending.size() : m.m_data_uncompressed.size();
+    ALGEBRA_VOLUME(multiply, nnz*(sizeof(I)+sizeof(U)) + m.m_inner.size()*sizeof(I) + (m.m_rows+m.m_cols)*k*sizeof(U), nnz);
+
+    std::vector<U> Y(m.m_rows*k);
+    bool by_rows= (layout==row_wise);
+    std::size_t x_row= by_rows ? k : 1, x_col= by_rows ? 1 : m.m_cols;
+    std::size_t y_row= by_rows ? k : 1, y_col= by_rows ? 1 : m.m_rows;
+
+    if(m.is_compressed()){
+        auto kernel= [&](auto K){
+            if(by_rows)
+                detail::multiVectorKernel<decltype(K)::value, true>(m, k, X.data(), x_row, x_col, Y.data(), y_row, y_col);
+            else
+                detail::multiVectorKernel<decltype(K)::value, false>(m, k, X.data(), x_row, x_col, Y.data(), y_row, y_col);
+        };
+        switch(k){
+            case 1:  kernel(std::integral_constant<std::size_t,1>{});  break;
+            case 2:  kernel(std::integral_constant<std::size_t,2>{});  break;
+            case 4:  kernel(std::integral_constant<std::size_t,4>{});  break;
+            case 8:  kernel(std::integral_constant<std::size_t,8>{});  break;
+            case 16: kernel(std::integral_constant<std::size_t,16>{}); break;
+            case 32: kernel(std::integral_constant<std::size_t,32>{}); break;
+            case 64: kernel(std::integral_constant<std::size_t,64>{}); break;
+            default: kernel(std::integral_constant<std::size_t,0>{});  break;
+        }
+        m.m_pending.forEach([&](const std::array<I,2> &key, const U &value){
+            for(std::size_t c=0; c<k; ++c)
+                Y[key[0]*y_row + c*y_col]+= value*X[key[1]*x_row + c*x_col];
+        });
+    }
+    else
+        //loop over non-zero elements of the uncompressed state
+        m.m_data_uncompressed.forEach([&](const std::array<I,2> &key, const U &value){
+            for(std::size_t c=0; c<k; ++c)
+                Y[key[0]*y_row + c*y_col]+= value*X[key[1]*x_row + c*x_col];
+        });
+
+    return Y;
+};
+
+};
+
+
+#endif /*MULTIVECTORPRODUCT_HPP*/
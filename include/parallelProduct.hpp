@@ -0,0 +1,91 @@
+#ifndef PARALLELPRODUCT_HPP
+#define PARALLELPRODUCT_HPP
+
+/**
+ * \file parallelProduct.hpp
+ * \brief Multithreaded matrix-vector product for compressed SparseMatrix objects
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "threadUtilities.hpp"
+#include "simdKernels.hpp"
+#include "instrumentation.hpp"
+#include <vector>
+
+namespace algebra{
+
+/**
+ * @brief Performs the matrix-vector multiplication on several threads.
+ *
+ * For the CSR format the rows are split into chunks with roughly the same number of non-zeros, found by
+ * searching m_inner, so that long rows don't leave threads idle. Every thread computes its own rows of the result
+ * with simd::csrRows.
+ * For the CSC format the columns are split the same way and every thread scatters its columns into a private
+ * partial result, the partial results are then summed row-chunk by row-chunk in parallel.
+ * Uncompressed matrices and matrices of one column use the serial operator*. The pending insertions
+ * (see SparseMatrix::finalize) are added serially.
+ * The vector may have a wider type than the values of the matrix (e.g. float or bfloat16 values and a vector of
+ * double, see castValues): the values are converted when read and the product is accumulated in the type of the
+ * vector, as in the mixed-precision operator*.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam X The type of the vector elements and of the sums, usually U.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix.
+ * @param v The vector.
+ * @param n_threads Number of threads, 0 uses one per hardware thread.
+ * @return The resulting vector of the matrix-vector multiplication.
+ * @note The CSC version needs (n_threads-1)*rows additional elements of memory.
+ */
+template<class U, class X, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<X> parallelProduct(const SparseMatrix<U,s,I,A> &m, const std::vector<X> &v, std::size_t n_threads){
+
+    if(!m.is_compressed() || m.m_cols==1)
+        return m*v;
+
+    if(m.m_cols!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<X>();
+    }
+
+    ALGEBRA_TIME(parallelProduct);
+    ALGEBRA_VOLUME(parallelProduct, m.m_values.size()*(sizeof(I)+sizeof(U)) + m.m_inner.size()*sizeof(I)
+                                    + (m.m_rows+m.m_cols)*sizeof(X), m.m_values.size());
+    n_threads= detail::threadCount(n_threads);
+    std::vector<X> res(m.m_rows);
+    std::vector<std::size_t> bounds= detail::partitionByNnz(m.m_inner, n_threads);
+
+    if constexpr (IsRowWise<s>::value){ //CSR, every thread owns its rows
+        detail::runChunks(bounds, [&](std::size_t, std::size_t first, std::size_t last){
+            simd::csrRows(first, last, m.m_inner.data(), m.m_outer.data(), m.m_values.data(), v.data(), res.data());
+        });
+    }
+    else{ //CSC, every thread scatters into its own buffer, the first one directly into res
+        std::vector<std::vector<X>> partial(n_threads-1, std::vector<X>(m.m_rows));
+        detail::runChunks(bounds, [&](std::size_t p, std::size_t first, std::size_t last){
+            std::vector<X> &out= (p==0) ? res : partial[p-1];
+            for(std::size_t i=first; i<last; ++i)
+                for(std::size_t j=m.m_inner[i]; j<m.m_inner[i+1]; ++j)
+                    out[m.m_outer[j]]+= static_cast<X>(m.m_values[j])*v[i];
+        });
+
+        //reduction of the partial results, every thread sums its own rows
+        if(!partial.empty())
+            detail::runChunks(detail::partitionEvenly(m.m_rows, n_threads), [&](std::size_t, std::size_t first, std::size_t last){
+                for(const auto &buffer: partial)
+                    for(std::size_t i=first; i<last; ++i)
+                        res[i]+= buffer[i];
+            });
+    }
+    m.addPendingProduct(res, v);
+
+    return res;
+};
+
+};
+
+
+#endif /*PARALLELPRODUCT_HPP*/
@@ -7,34 +7,112 @@
  */
 
 #include "SparseMatrix.hpp"
+#include "MappedFile.hpp"
+#include "threadUtilities.hpp"
+#include "instrumentation.hpp"
 #include <iostream>
 #include <fstream>
 #include <limits>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <complex>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <span>
+#include <vector>
 
 namespace algebra{
 
+/**
+ * \brief Symmetry field of the Matrix Market banner: but for general, only one triangle of the matrix is listed
+ */
+enum class MarketSymmetry{
+    general, symmetric, skew_symmetric, hermitian
+};
+
+namespace detail{
+
+/**
+ * \brief Symmetry field of a Matrix Market banner
+ * \param banner The first line of the file, in lower case
+ * \return The symmetry, general if the field is missing
+ */
+inline MarketSymmetry marketSymmetry(const std::string &banner){
+    if(banner.find("skew-symmetric")!=std::string::npos)
+        return MarketSymmetry::skew_symmetric;
+    if(banner.find("symmetric")!=std::string::npos)
+        return MarketSymmetry::symmetric;
+    if(banner.find("hermitian")!=std::string::npos)
+        return MarketSymmetry::hermitian;
+    return MarketSymmetry::general;
+};
+
+/**
+ * \brief Value of the element (j,i) of a matrix with the given symmetry, from the element (i,j)
+ */
+template<class U>
+U mirroredValue(const U &value, MarketSymmetry symmetry){
+    if(symmetry==MarketSymmetry::skew_symmetric)
+        return -value;
+    if constexpr (!std::is_arithmetic_v<U> && requires { std::conj(value); })
+        if(symmetry==MarketSymmetry::hermitian)
+            return std::conj(value);
+    return value;
+};
+
+/**
+ * \brief Appends the mirrored element (j,i) of every off-diagonal element (i,j) of a listed triangle
+ */
+template<class U>
+void mirrorEntries(std::vector<Triplet<U>> &entries, MarketSymmetry symmetry){
+    if(symmetry==MarketSymmetry::general)
+        return;
+    std::size_t listed= entries.size();
+    for(std::size_t k=0; k<listed; ++k)
+        if(entries[k].row!=entries[k].col)
+            entries.push_back({entries[k].col, entries[k].row, mirroredValue(entries[k].value, symmetry)});
+};
+
+}
+
 /**
  * \brief Method to read a matrix in Matrix Market format
+ *
+ * The comment lines are skipped; the matrices with a symmetric, skew-symmetric or hermitian banner list only one
+ * triangle, the other one is added.
+ *
  * \tparam U Type of the stored element
  * \tparam s Storage order
+ * \tparam I Index type
+ * \tparam A Assembly backend
  * \param filename The name of the file to read
  * \return The matrix read from the file
  */
-template<class U,StorageOrder s>
-SparseMatrix<U,s> readMatrixMarket(const std::string& filename) {
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> readMatrixMarket(const std::string& filename) {
+     ALGEBRA_TIME(readMatrixMarket);
      std::ifstream file(filename);
 
      if (!file.is_open()) {
          std::cerr << "Failed to open file: " << filename << std::endl;
      }     
 
-     file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+     //banner and comments
+     std::string banner;
+     std::getline(file, banner);
+     std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c){ return std::tolower(c); });
+     MarketSymmetry symmetry= detail::marketSymmetry(banner);
+     while(file.peek()=='%')
+         file.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
 
      //number of rows, columns and non-zero elements
      std::size_t rows, cols, nnz;
      file >> rows >> cols >> nnz;  
 
-     SparseMatrix<U,s> matrix(rows, cols); 
+     SparseMatrix<U,s,I,A> matrix(rows, cols); 
+     ALGEBRA_VOLUME(readMatrixMarket, 0, nnz);
       
      //fill matrix
      for (std::size_t i = 0; i < nnz; ++i) {
@@ -42,11 +120,246 @@ SparseMatrix<U,s> readMatrixMarket(const std::string& filename) {
          U value;
          file >> row >> col >> value;
          matrix(row-1,col-1)= value;
+         if(symmetry!=MarketSymmetry::general && row!=col)
+             matrix(col-1,row-1)= detail::mirroredValue(value, symmetry);
      }
 
      return matrix;
 };
 
+namespace detail{
+
+/**
+ * \brief Skips spaces, tabs and carriage returns
+ * \return Pointer to the first other character, or end
+ */
+inline const char * skipBlanks(const char *p, const char *end){
+    while(p<end && (*p==' ' || *p=='\t' || *p=='\r'))
+        ++p;
+    return p;
+};
+
+/**
+ * \brief Moves to the beginning of the next line
+ * \return Pointer to the character after the next newline, or end
+ */
+inline const char * nextLine(const char *p, const char *end){
+    p= static_cast<const char*>(std::memchr(p, '\n', end-p));
+    return p ? p+1 : end;
+};
+
+/**
+ * \brief Parses one number with std::from_chars, after skipping blanks
+ * \tparam N Arithmetic type of the number
+ * \param p Where to start
+ * \param end End of the buffer
+ * \param x Where to store the parsed number
+ * \return Pointer past the number, nullptr if p is null or no number was found
+ */
+template<class N>
+const char * parseNumber(const char *p, const char *end, N &x){
+    if(!p)
+        return nullptr;
+    p= skipBlanks(p, end);
+    //from_chars does not accept an explicit plus sign
+    if(p<end && *p=='+')
+        ++p;
+    auto [q, ec]= std::from_chars(p, end, x);
+    return ec==std::errc() ? q : nullptr;
+};
+
+/**
+ * \brief Parses the coordinate lines in [p, end)
+ * \tparam U Type of the stored element
+ * \param p Beginning of the chunk, at the beginning of a line
+ * \param end End of the chunk, at the beginning of a line or at the end of the file
+ * \param rows Number of rows, for checking the indexes
+ * \param cols Number of columns, for checking the indexes
+ * \param pattern true if the lines have no value (the value is then 1)
+ * \param out Where to append the entries
+ * \return Number of malformed or out of range lines
+ */
+template<class U>
+std::size_t parseMarketChunk(const char *p, const char *end, std::size_t rows, std::size_t cols, bool pattern, std::vector<Triplet<U>> &out){
+    std::size_t bad=0;
+    while(p<end){
+        p= skipBlanks(p, end);
+        if(p==end)
+            break;
+        if(*p=='\n' || *p=='%'){ //empty line or comment
+            p= nextLine(p, end);
+            continue;
+        }
+        std::size_t row, col;
+        U value= U(1);
+        const char *q= parseNumber(parseNumber(p, end, row), end, col);
+        if(!pattern)
+            q= parseNumber(q, end, value);
+        if(!q || row==0 || col==0 || row>rows || col>cols)
+            ++bad;
+        else
+            out.push_back({row-1, col-1, value});
+        p= nextLine(q ? q : p, end);
+    }
+    return bad;
+};
+
+}
+
+namespace detail{
+
+/**
+ * \brief Entries of a Matrix Market file, as parsed by parseMarketFile
+ * \tparam U Type of the stored element
+ */
+template<class U>
+struct MarketEntries{
+    std::size_t rows=0, cols=0;
+    //number of entries declared in the size line
+    std::size_t nnz=0;
+    std::size_t bytes=0;
+    MarketSymmetry symmetry= MarketSymmetry::general;
+    //entries of every thread, in the order of the file
+    std::vector<std::vector<Triplet<U>>> chunks;
+};
+
+/**
+ * @brief Parses a Matrix Market coordinate file through a memory mapping, in parallel.
+ *
+ * The banner, the comment lines and the size line are read serially; the coordinate lines are then split in
+ * chunks at newline boundaries and parsed in parallel with std::from_chars. Every thread then calls transform on its
+ * own entries, e.g. for adding the other triangle of a symmetric matrix.
+ *
+ * @tparam U Type of the stored element, it must be an arithmetic type.
+ * @tparam Transform The type of the callable taking (std::vector<Triplet<U>> &entries, MarketSymmetry symmetry).
+ * @param filename The name of the file to read.
+ * @param n_threads Number of threads, 0 means one per hardware thread.
+ * @param transform The callable, run by every thread on its entries.
+ * @param out Where the dimensions, the symmetry and the entries are stored.
+ * @return false (and an error is printed) if the file cannot be read.
+ */
+template<class U, class Transform>
+bool parseMarketFile(const std::string& filename, std::size_t n_threads, Transform transform, MarketEntries<U> &out){
+     MappedFile file(filename);
+     if(!file.is_open())
+         return false;
+     file.advise(MADV_SEQUENTIAL);
+     out.bytes= file.size();
+
+     const char *p= file.data();
+     const char *end= p+file.size();
+
+     //banner: %%MatrixMarket matrix coordinate <field> <symmetry>
+     bool pattern=false;
+     const char *eol= nextLine(p, end);
+     if(eol-p>=14 && std::strncmp(p, "%%MatrixMarket", 14)==0){
+         std::string banner(p, eol);
+         std::transform(banner.begin(), banner.end(), banner.begin(), [](unsigned char c){ return std::tolower(c); });
+         if(banner.find("coordinate")==std::string::npos){
+             std::cerr << "Only the coordinate format is supported: " << filename << std::endl;
+             return false;
+         }
+         pattern= banner.find("pattern")!=std::string::npos;
+         out.symmetry= marketSymmetry(banner);
+     }
+
+     //comments and size line
+     while(p<end){
+         const char *q= skipBlanks(p, end);
+         if(q<end && *q!='%' && *q!='\n')
+             break;
+         p= nextLine(p, end);
+     }
+     const char *body= parseNumber(parseNumber(parseNumber(p, end, out.rows), end, out.cols), end, out.nnz);
+     if(!body){
+         std::cerr << "Missing size line in file: " << filename << std::endl;
+         return false;
+     }
+     body= nextLine(body, end);
+
+     //split the coordinate lines in chunks that begin at the beginning of a line
+     n_threads= threadCount(n_threads);
+     std::vector<std::size_t> bounds(n_threads+1);
+     std::size_t body_size= end-body;
+     bounds[n_threads]= body_size;
+     for(std::size_t t=1; t<n_threads; ++t){
+         std::size_t pos= std::max<std::size_t>(body_size*t/n_threads, 1);
+         pos= nextLine(body+pos-1, end) - body;
+         bounds[t]= std::max(pos, bounds[t-1]);
+     }
+
+     //parse the chunks, one per thread
+     out.chunks.assign(n_threads, {});
+     std::vector<std::size_t> bad(n_threads), read(n_threads);
+     runChunks(bounds, [&](std::size_t t, std::size_t first, std::size_t last){
+         out.chunks[t].reserve((out.symmetry==MarketSymmetry::general ? 1 : 2)*(out.nnz/n_threads + 1));
+         bad[t]= parseMarketChunk(body+first, body+last, out.rows, out.cols, pattern, out.chunks[t]);
+         read[t]= out.chunks[t].size();
+         transform(out.chunks[t], out.symmetry);
+     });
+
+     std::size_t n_bad=0, n_read=0;
+     for(std::size_t t=0; t<n_threads; ++t){
+         n_bad+= bad[t];
+         n_read+= read[t];
+     }
+     if(n_bad)
+         std::cerr << n_bad << " malformed or out of range lines skipped in file: " << filename << std::endl;
+     if(n_read+n_bad!=out.nnz)
+         std::cerr << "Expected " << out.nnz << " entries, found " << n_read+n_bad << " in file: " << filename << std::endl;
+     return true;
+};
+
+}
+
+/**
+ * @brief Reads a matrix in Matrix Market coordinate format through a memory mapping of the file.
+ *
+ * The file is parsed in parallel by detail::parseMarketFile; the matrices with a symmetric, skew-symmetric or
+ * hermitian banner list only one triangle, the other one is added by the parsing threads.
+ * The compressed vectors are filled directly by a counting sort on the row (CSR) or column (CSC) index
+ * (see SparseMatrix::setFromTriplets), without building the map of the uncompressed state. If an entry appears more than once, the last one is kept,
+ * as in readMatrixMarket.
+ *
+ * @tparam U Type of the stored element, it must be an arithmetic type
+ * @tparam s Storage order
+ * @tparam I Index type.
+ * @tparam A Assembly backend.
+ * @param filename The name of the file to read
+ * @param n_threads Number of threads, 0 means one per hardware thread
+ * @return The compressed matrix read from the file
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> readMatrixMarketMapped(const std::string& filename, std::size_t n_threads){
+     static_assert(std::is_arithmetic_v<U>, "readMatrixMarketMapped parses arithmetic types only");
+     ALGEBRA_TIME(readMatrixMarketMapped);
+
+     detail::MarketEntries<U> entries;
+     if(!detail::parseMarketFile<U>(filename, n_threads, [](std::vector<Triplet<U>> &chunk, MarketSymmetry symmetry){
+             detail::mirrorEntries(chunk, symmetry);
+         }, entries))
+         return SparseMatrix<U,s,I,A>(0,0);
+
+     std::size_t n_read=0;
+     std::vector<std::span<const Triplet<U>>> chunks;
+     for(const auto &chunk: entries.chunks){
+         n_read+= chunk.size();
+         chunks.push_back(chunk);
+     }
+     if(!fitsIndex<I>(entries.rows, entries.cols, n_read)){
+         std::cerr << "The matrix does not fit in the index type, file: " << filename << std::endl;
+         return SparseMatrix<U,s,I,A>(0,0);
+     }
+
+     //counting sort of the chunks, of repeated entries the last one is kept
+     SparseMatrix<U,s,I,A> matrix(entries.rows, entries.cols);
+     ALGEBRA_VOLUME(readMatrixMarketMapped, entries.bytes, n_read);
+     if(!matrix.assembleCompressed(chunks, [](const U &, const U &repeated){ return repeated; }))
+         return SparseMatrix<U,s,I,A>(0,0);
+
+     return matrix;
+};
+
 
 }
 
@@ -0,0 +1,478 @@
+#ifndef REORDERING_HPP
+#define REORDERING_HPP
+
+/**
+ * \file reordering.hpp
+ * \brief Reorderings of the rows and columns of a square SparseMatrix (reverse Cuthill-McKee, recursive bisection)
+ *        for the locality of the product, bandwidth and profile
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "threadUtilities.hpp"
+#include <algorithm>
+#include <iostream>
+#include <numeric>
+#include <span>
+#include <utility>
+#include <vector>
+
+namespace algebra{
+
+/**
+ * \brief Orderings computed by reorder
+ */
+enum class Ordering{
+    reverse_cuthill_mckee, bisection
+};
+
+/**
+ * \brief Symmetrically permuted copy of a matrix and its permutation, see reorder
+ *
+ * The product y = A*x is computed as y = unpermuteVector(matrix*permuteVector(x, permutation), permutation).
+ *
+ * \tparam U Type of the stored elements
+ * \tparam s Storage order
+ * \tparam I Index type
+ * \tparam A Assembly backend
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+struct ReorderedMatrix{
+    /**
+     * \brief The compressed matrix P*A*P^T, whose element (k,h) is the element (permutation[k], permutation[h]) of A
+     */
+    SparseMatrix<U,s,I,A> matrix{0,0};
+    /**
+     * \brief permutation[k] is the old index of the new index k
+     */
+    std::vector<std::size_t> permutation;
+    /**
+     * \brief inverse[i] is the new index of the old index i
+     */
+    std::vector<std::size_t> inverse;
+};
+
+namespace detail{
+
+/**
+ * \brief Adjacency graph of the pattern of A+A^T, without the diagonal, in compressed form
+ */
+struct AdjacencyGraph{
+
+    std::vector<std::size_t> offsets;
+    std::vector<std::size_t> neighbours;
+
+    std::size_t size() const {return offsets.size()-1;};
+    std::size_t degree(std::size_t i) const {return offsets[i+1]-offsets[i];};
+    std::span<const std::size_t> operator[](std::size_t i) const {return {neighbours.data()+offsets[i], degree(i)};};
+
+};
+
+/**
+ * \brief Builds the adjacency graph of a square compressed matrix, of either storage order
+ * \param inner The inner vector of the matrix
+ * \param outer The outer vector of the matrix
+ */
+template <class I>
+AdjacencyGraph adjacencyGraph(std::span<const I> inner, std::span<const I> outer){
+    std::size_t n= inner.size()-1;
+    AdjacencyGraph graph;
+    //every off-diagonal element (i,j) is the edge i-j and the edge j-i
+    graph.offsets.assign(n+1, 0);
+    for(std::size_t i=0; i<n; ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j)
+            if(outer[j]!=i){
+                ++graph.offsets[i+1];
+                ++graph.offsets[outer[j]+1];
+            }
+    std::partial_sum(graph.offsets.begin(), graph.offsets.end(), graph.offsets.begin());
+    std::vector<std::size_t> next(graph.offsets.begin(), graph.offsets.end()-1);
+    graph.neighbours.resize(graph.offsets[n]);
+    for(std::size_t i=0; i<n; ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j)
+            if(outer[j]!=i){
+                graph.neighbours[next[i]++]= outer[j];
+                graph.neighbours[next[outer[j]]++]= i;
+            }
+    //the symmetric elements gave the same edge twice
+    std::size_t size=0;
+    for(std::size_t i=0; i<n; ++i){
+        auto first= graph.neighbours.begin()+graph.offsets[i], last= graph.neighbours.begin()+graph.offsets[i+1];
+        std::sort(first, last);
+        last= std::unique(first, last);
+        graph.offsets[i]= size;
+        size= std::copy(first, last, graph.neighbours.begin()+size) - graph.neighbours.begin();
+    }
+    graph.offsets[n]= size;
+    graph.neighbours.resize(size);
+    return graph;
+};
+
+/**
+ * \brief Breadth-first search restricted to the nodes with label[node]==label_value
+ *
+ * With sort_by_degree the neighbours of every node are visited by increasing degree (Cuthill-McKee).
+ *
+ * \param graph The adjacency graph
+ * \param root The first node, labelled label_value
+ * \param label The labels of the nodes, the visited ones get visited_label
+ * \param label_value The label of the nodes to visit
+ * \param visited_label The label given to the visited nodes
+ * \param order Where the visited nodes are appended
+ * \param sort_by_degree true for visiting the neighbours by increasing degree
+ * \return The number of levels and the position in order of the first node of the last level
+ */
+inline std::pair<std::size_t,std::size_t> breadthFirst(const AdjacencyGraph &graph, std::size_t root, std::vector<std::size_t> &label,
+                                                       std::size_t label_value, std::size_t visited_label,
+                                                       std::vector<std::size_t> &order, bool sort_by_degree){
+    std::size_t head= order.size(), level_begin= head, level_end= head+1, levels=1;
+    order.push_back(root);
+    label[root]= visited_label;
+    while(head<order.size()){
+        //all the nodes of the next level have been appended
+        if(head==level_end){
+            level_begin= level_end;
+            level_end= order.size();
+            ++levels;
+        }
+        std::size_t node= order[head++];
+        std::size_t first= order.size();
+        for(std::size_t neighbour: graph[node])
+            if(label[neighbour]==label_value){
+                label[neighbour]= visited_label;
+                order.push_back(neighbour);
+            }
+        if(sort_by_degree)
+            std::stable_sort(order.begin()+first, order.end(), [&graph](std::size_t a, std::size_t b){
+                return graph.degree(a)<graph.degree(b);
+            });
+    }
+    return {levels, level_begin};
+};
+
+/**
+ * \brief Pseudo-peripheral node of the connected nodes labelled label_value that include start (George-Liu)
+ *
+ * The node of minimum degree in the last level of a breadth-first search is taken as the new root, as long as its
+ * search has more levels.
+ *
+ * \note The labels are changed to scratch_label and restored
+ */
+inline std::size_t pseudoPeripheralNode(const AdjacencyGraph &graph, std::size_t start, std::vector<std::size_t> &label,
+                                        std::size_t label_value, std::size_t scratch_label){
+    std::vector<std::size_t> order;
+    std::size_t node= start, levels=0;
+    while(true){
+        order.clear();
+        auto [new_levels, last_level]= breadthFirst(graph, node, label, label_value, scratch_label, order, false);
+        for(std::size_t visited: order)
+            label[visited]= label_value;
+        if(new_levels<=levels)
+            return node;
+        levels= new_levels;
+        node= *std::min_element(order.begin()+last_level, order.end(), [&graph](std::size_t a, std::size_t b){
+            return graph.degree(a)<graph.degree(b);
+        });
+    }
+};
+
+/**
+ * \brief Cuthill-McKee order of the nodes labelled label_value among order[first,last), which it replaces
+ *
+ * Every connected part starts from a pseudo-peripheral node; the nodes get the label visited_label.
+ */
+inline void cuthillMcKee(const AdjacencyGraph &graph, std::vector<std::size_t> &order, std::size_t first, std::size_t last,
+                         std::vector<std::size_t> &label, std::size_t label_value, std::size_t visited_label,
+                         std::size_t scratch_label){
+    std::vector<std::size_t> nodes(order.begin()+first, order.begin()+last);
+    std::vector<std::size_t> new_order;
+    new_order.reserve(nodes.size());
+    for(std::size_t node: nodes)
+        if(label[node]==label_value){
+            std::size_t root= pseudoPeripheralNode(graph, node, label, label_value, scratch_label);
+            breadthFirst(graph, root, label, label_value, visited_label, new_order, true);
+        }
+    std::copy(new_order.begin(), new_order.end(), order.begin()+first);
+};
+
+/**
+ * \brief Splits order[first,last) in n_parts parts of consecutive nodes in Cuthill-McKee order, recursively in two
+ *        halves of the order, so that every part is (mostly) connected and only its boundary is adjacent to other
+ *        parts
+ * \param next_label The first label not in use, incremented
+ */
+inline void bisect(const AdjacencyGraph &graph, std::vector<std::size_t> &order, std::size_t first, std::size_t last,
+                   std::size_t n_parts, std::vector<std::size_t> &label, std::size_t &next_label){
+    std::size_t label_value= next_label++;
+    std::size_t visited_label= next_label++, scratch_label= next_label++;
+    for(std::size_t k=first; k<last; ++k)
+        label[order[k]]= label_value;
+    cuthillMcKee(graph, order, first, last, label, label_value, visited_label, scratch_label);
+    if(n_parts<2 || last-first<2)
+        return;
+    std::size_t left_parts= n_parts/2;
+    std::size_t middle= first + (last-first)*left_parts/n_parts;
+    bisect(graph, order, first, middle, left_parts, label, next_label);
+    bisect(graph, order, middle, last, n_parts-left_parts, label, next_label);
+};
+
+}
+
+/**
+ * @brief Computes the reverse Cuthill-McKee ordering of a square matrix.
+ *
+ * The ordering is computed on the graph of the pattern of A+A^T: every connected part is visited breadth first from
+ * a pseudo-peripheral node, with the neighbours of every node by increasing degree, and the order is reversed.
+ * The nonzeros of the permuted matrix gather near the diagonal, so that the elements of the vector read by the rows
+ * of the product are close to each other.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The square sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @return The permutation, permutation[k] is the old index of the new index k; empty if m is not square.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<std::size_t> reverseCuthillMcKee(const SparseMatrix<U,s,I,A> &m){
+    if(m.rows()!=m.cols()){
+        std::cerr << "Only a square matrix can be reordered\n";
+        return {};
+    }
+    if(!m.is_compressed() || m.pending()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return {};
+        return reverseCuthillMcKee(copy);
+    }
+    detail::AdjacencyGraph graph= detail::adjacencyGraph(m.inner(), m.outer());
+    std::size_t n= graph.size();
+    //the connected parts are started from their nodes of minimum degree
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&graph](std::size_t a, std::size_t b){ return graph.degree(a)<graph.degree(b); });
+    std::vector<std::size_t> label(n, 0);
+    detail::cuthillMcKee(graph, order, 0, n, label, 0, 1, 2);
+    std::reverse(order.begin(), order.end());
+    return order;
+};
+
+/**
+ * @brief Computes an ordering of a square matrix made of n_parts parts, by recursive bisection of its graph.
+ *
+ * The nodes of the graph of A+A^T are ordered by Cuthill-McKee and split in two halves, which are ordered and split
+ * again until there are n_parts parts. Every part is a block of consecutive rows that reads mostly its own elements
+ * of the vector, e.g. one part per thread of parallelProduct.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The square sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @param n_parts The number of parts, 0 means one per hardware thread.
+ * @return The permutation, permutation[k] is the old index of the new index k; empty if m is not square.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<std::size_t> bisectionOrdering(const SparseMatrix<U,s,I,A> &m, std::size_t n_parts=0){
+    if(m.rows()!=m.cols()){
+        std::cerr << "Only a square matrix can be reordered\n";
+        return {};
+    }
+    if(!m.is_compressed() || m.pending()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return {};
+        return bisectionOrdering(copy, n_parts);
+    }
+    detail::AdjacencyGraph graph= detail::adjacencyGraph(m.inner(), m.outer());
+    std::size_t n= graph.size();
+    std::vector<std::size_t> order(n);
+    std::iota(order.begin(), order.end(), 0);
+    std::vector<std::size_t> label(n, 0);
+    std::size_t next_label= 0;
+    detail::bisect(graph, order, 0, n, detail::threadCount(n_parts), label, next_label);
+    return order;
+};
+
+/**
+ * @brief Permutes the rows and the columns of a square matrix with the same permutation, P*A*P^T.
+ *
+ * The rows (columns) are copied in the new order, their indexes are renumbered and sorted.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The square sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @param permutation The permutation, permutation[k] is the old index of the new index k.
+ * @return The compressed permuted matrix, empty if m is not square, the permutation has another size or it is not a
+ *         permutation (an index out of range or repeated).
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> permute(const SparseMatrix<U,s,I,A> &m, const std::vector<std::size_t> &permutation){
+    if(m.m_rows!=m.m_cols || permutation.size()!=m.m_rows){
+        std::cerr << "Dimensions are incompatible\n";
+        return SparseMatrix<U,s,I,A>(0,0);
+    }
+    //every old index must appear once, n marks the ones not seen yet
+    std::size_t n= m.m_rows;
+    std::vector<std::size_t> inverse(n, n);
+    for(std::size_t k=0; k<n; ++k){
+        if(permutation[k]>=n || inverse[permutation[k]]!=n){
+            std::cerr << "The vector is not a permutation\n";
+            return SparseMatrix<U,s,I,A>(0,0);
+        }
+        inverse[permutation[k]]= k;
+    }
+    if(!m.m_compressed || !m.m_pending.empty()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return SparseMatrix<U,s,I,A>(0,0);
+        return permute(copy, permutation);
+    }
+
+    SparseMatrix<U,s,I,A> res(n, n);
+    res.m_inner.resize(n+1);
+    res.m_outer.resize(m.m_outer.size());
+    res.m_values.resize(m.m_values.size());
+    res.m_inner[0]= 0;
+    std::vector<std::pair<I,U>> row;
+    for(std::size_t k=0; k<n; ++k){
+        std::size_t i= permutation[k];
+        row.clear();
+        for(std::size_t j=m.m_inner[i]; j<m.m_inner[i+1]; ++j)
+            row.emplace_back(static_cast<I>(inverse[m.m_outer[j]]), m.m_values[j]);
+        std::sort(row.begin(), row.end(), [](const auto &a, const auto &b){ return a.first<b.first; });
+        std::size_t start= res.m_inner[k];
+        for(std::size_t h=0; h<row.size(); ++h){
+            res.m_outer[start+h]= row[h].first;
+            res.m_values[start+h]= row[h].second;
+        }
+        res.m_inner[k+1]= start+row.size();
+    }
+    res.m_compressed= true;
+    return res;
+};
+
+/**
+ * @brief Reorders a square matrix for the locality of the product.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The square sparse matrix.
+ * @param ordering The ordering, reverse Cuthill-McKee or recursive bisection.
+ * @param n_parts The number of parts of the bisection, 0 means one per hardware thread.
+ * @return The permuted matrix with its permutation and the inverse, all empty if m is not square.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+ReorderedMatrix<U,s,I,A> reorder(const SparseMatrix<U,s,I,A> &m, Ordering ordering=Ordering::reverse_cuthill_mckee,
+                                 std::size_t n_parts=0){
+    std::vector<std::size_t> permutation= ordering==Ordering::bisection ? bisectionOrdering(m, n_parts) : reverseCuthillMcKee(m);
+    if(permutation.size()!=m.rows())
+        return {SparseMatrix<U,s,I,A>(0,0), {}, {}};
+    std::vector<std::size_t> inverse(permutation.size());
+    for(std::size_t k=0; k<permutation.size(); ++k)
+        inverse[permutation[k]]= k;
+    return {permute(m, permutation), std::move(permutation), std::move(inverse)};
+};
+
+/**
+ * @brief Permutes a vector, to be multiplied by a permuted matrix.
+ *
+ * @tparam U The type of the vector elements.
+ * @param v The vector, in the old numbering.
+ * @param permutation The permutation, permutation[k] is the old index of the new index k.
+ * @return The vector in the new numbering, w[k]=v[permutation[k]]; empty if the sizes differ.
+ */
+template<class U>
+std::vector<U> permuteVector(const std::vector<U> &v, const std::vector<std::size_t> &permutation){
+    if(v.size()!=permutation.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    std::vector<U> w(v.size());
+    for(std::size_t k=0; k<w.size(); ++k)
+        w[k]= v[permutation[k]];
+    return w;
+};
+
+/**
+ * @brief Brings a vector, e.g. the product of a permuted matrix, back to the old numbering.
+ *
+ * @tparam U The type of the vector elements.
+ * @param w The vector, in the new numbering.
+ * @param permutation The permutation, permutation[k] is the old index of the new index k.
+ * @return The vector in the old numbering, v[permutation[k]]=w[k]; empty if the sizes differ.
+ */
+template<class U>
+std::vector<U> unpermuteVector(const std::vector<U> &w, const std::vector<std::size_t> &permutation){
+    if(w.size()!=permutation.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    std::vector<U> v(w.size());
+    for(std::size_t k=0; k<w.size(); ++k)
+        v[permutation[k]]= w[k];
+    return v;
+};
+
+/**
+ * @brief Computes the bandwidth of a matrix, the maximum distance |i-j| of a stored element (i,j) from the diagonal.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The compressed sparse matrix, its pending insertions are not counted.
+ * @return The bandwidth, 0 for a diagonal (or uncompressed) matrix.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::size_t bandwidth(const SparseMatrix<U,s,I,A> &m){
+    std::span<const I> inner= m.inner(), outer= m.outer();
+    std::size_t width=0;
+    for(std::size_t i=0; i+1<inner.size(); ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j)
+            width= std::max<std::size_t>(width, outer[j]>i ? outer[j]-i : i-outer[j]);
+    return width;
+};
+
+/**
+ * @brief Computes the profile (envelope size) of a matrix, the sum over the rows i of i-f(i), where f(i) is the
+ *        first column of a stored element of row i at or before the diagonal (i if none).
+ *
+ * For a symmetric pattern it is the number of elements that a skyline factorization stores below the diagonal.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The compressed sparse matrix, its pending insertions are not counted.
+ * @return The profile, 0 for an upper triangular (or uncompressed) matrix.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::size_t profile(const SparseMatrix<U,s,I,A> &m){
+    std::span<const I> inner= m.inner(), outer= m.outer();
+    std::vector<std::size_t> first(m.rows());
+    std::iota(first.begin(), first.end(), 0);
+    for(std::size_t i=0; i+1<inner.size(); ++i)
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j){
+            std::size_t r= IsRowWise<s>::value ? i : outer[j];
+            std::size_t c= IsRowWise<s>::value ? outer[j] : i;
+            if(c<first[r])
+                first[r]= c;
+        }
+    std::size_t size=0;
+    for(std::size_t r=0; r<first.size(); ++r)
+        size+= r-first[r];
+    return size;
+};
+
+};
+
+
+#endif /*REORDERING_HPP*/
@@ -0,0 +1,58 @@
+#ifndef SEARCHUTILITIES_HPP
+#define SEARCHUTILITIES_HPP
+
+/**
+ * \file searchUtilities.hpp
+ * \brief Helpers for searching an index inside a row (column) of a compressed matrix
+ */
+
+// clang-format off
+#include <cstddef>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Length under which a sorted range is searched with a linear scan instead of halving it
+ *
+ * The scan has no branches and is vectorized by the compiler: on 32 indexes it is faster than the remaining
+ * five steps of binary search, whose branches are unpredictable.
+ */
+inline constexpr std::size_t linear_search_threshold= 32;
+
+/**
+ * \brief First position in [first, last) whose index is not less than o, last if there is none
+ *
+ * The range is halved while it is longer than linear_search_threshold, then the smaller indexes are counted.
+ * The element with index o is at the returned position p if p<last and outer[p]==o.
+ *
+ * \tparam I Type of the indexes
+ * \param outer m_outer of the matrix, sorted inside every row (column)
+ * \param first Start of the row (column)
+ * \param last End of the row (column)
+ * \param o The searched column (row) index, representable by I
+ * \return The position of the lower bound of o
+ */
+template <class I>
+std::size_t lowerBoundOuter(const I *outer, std::size_t first, std::size_t last, std::size_t o){
+    const I key= static_cast<I>(o);
+    while(last-first > linear_search_threshold){
+        std::size_t middle= first+(last-first)/2;
+        if(outer[middle]<key)
+            first= middle+1;
+        else
+            last= middle;
+    }
+    std::size_t count=0;
+    for(std::size_t j=first; j<last; ++j)
+        count+= outer[j]<key;
+    return first+count;
+};
+
+}
+
+};
+
+
+#endif /*SEARCHUTILITIES_HPP*/
@@ -0,0 +1,405 @@
+#ifndef SIMDKERNELS_HPP
+#define SIMDKERNELS_HPP
+
+/**
+ * \file simdKernels.hpp
+ * \brief Hand-written SIMD kernels of the CSR matrix-vector product, selected at runtime
+ */
+
+// clang-format off
+#include "bfloat16.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <type_traits>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ALGEBRA_X86_SIMD 1
+#include <immintrin.h>
+#else
+#define ALGEBRA_X86_SIMD 0
+#endif
+
+namespace algebra{
+
+namespace simd{
+
+/**
+ * \brief Instruction sets with a kernel, from the narrowest to the widest
+ */
+enum Isa{
+    scalar, sse2, avx2, avx512
+};
+
+/**
+ * \brief Name of an instruction set
+ * \param isa The instruction set
+ * \return Its name
+ */
+inline const char * isaName(Isa isa){
+    switch(isa){
+        case sse2: return "sse2";
+        case avx2: return "avx2";
+        case avx512: return "avx512";
+        default: return "scalar";
+    }
+};
+
+/**
+ * \brief Widest instruction set supported by the CPU, read from CPUID
+ * \return The instruction set
+ */
+inline Isa detectIsa(){
+#if ALGEBRA_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f"))
+        return avx512;
+    if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        return avx2;
+    if(__builtin_cpu_supports("sse2"))
+        return sse2;
+#endif
+    return scalar;
+};
+
+/**
+ * \brief Instruction set used by the kernels, the widest supported one unless changed by setIsa
+ * \return Reference to the instruction set in use
+ */
+inline Isa & activeIsa(){
+    static Isa isa= detectIsa();
+    return isa;
+};
+
+/**
+ * \brief Chooses the instruction set used by the kernels (e.g. for comparing them)
+ * \param isa The wanted instruction set, if the CPU does not support it the widest supported one is used
+ * \return The instruction set in use
+ */
+inline Isa setIsa(Isa isa){
+    activeIsa()= std::min(isa, detectIsa());
+    return activeIsa();
+};
+
+/**
+ * \brief Portable CSR product of the rows [first, last), the reference for every type
+ *
+ * The values may be stored in a narrower type than the vectors, they are converted to the type of the vectors,
+ * where the sums are done.
+ *
+ * \tparam V Type of the stored values
+ * \tparam T Type of the vectors and of the sums
+ * \tparam I Type of the indexes
+ * \param first First row
+ * \param last One past the last row
+ * \param inner m_inner of the matrix
+ * \param outer m_outer of the matrix
+ * \param values m_values of the matrix
+ * \param x The vector
+ * \param y The result, y[i] is overwritten for every row i in [first, last)
+ */
+template <class V, class T, class I>
+void csrRowsScalar(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                   const V *values, const T *x, T *y){
+    for(std::size_t i=first; i<last; ++i){
+        T sum = T();
+        for(std::size_t j=inner[i]; j<inner[i+1]; ++j)
+            sum += static_cast<T>(values[j])*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+/**
+ * \brief Tells if the kernels read indexes of type I, unsigned of 32 or 64 bits
+ */
+template <class I>
+inline constexpr bool isKernelIndex= std::is_unsigned_v<I> && (sizeof(I)==4 || sizeof(I)==8);
+
+#if ALGEBRA_X86_SIMD
+
+namespace detail{
+
+//4 indexes, 32-bit ones are zero-extended to 64 bits for the gathers
+template <class I>
+__attribute__((target("avx2")))
+inline __m256i loadIndexes4(const I *p){
+    if constexpr (sizeof(I)==8)
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    else
+        return _mm256_cvtepu32_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+};
+
+//the first indexes of 8 selected by mask, the others are 0
+//(32-bit remainders go through a local buffer, masked 256-bit loads would need AVX-512VL)
+template <class I>
+__attribute__((target("avx512f")))
+inline __m512i loadIndexes8(__mmask8 mask, const I *p){
+    if constexpr (sizeof(I)==8)
+        return _mm512_maskz_loadu_epi64(mask, p);
+    else{
+        if(mask==0xFF)
+            return _mm512_maskz_cvtepu32_epi64(0xFF, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)));
+        alignas(32) I tail[8]= {};
+        for(int k=0; k<8 && (mask>>k)&1; ++k)
+            tail[k]= p[k];
+        return _mm512_maskz_cvtepu32_epi64(0xFF, _mm256_load_si256(reinterpret_cast<const __m256i*>(tail)));
+    }
+};
+
+//double, 2 lanes, no gather in SSE2
+template <class I>
+__attribute__((target("sse2")))
+inline void csrRowsSse2(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                        const double *values, const double *x, double *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m128d acc= _mm_setzero_pd();
+        for(; j+2<=end; j+=2)
+            acc= _mm_add_pd(acc, _mm_mul_pd(_mm_loadu_pd(values+j), _mm_set_pd(x[outer[j+1]], x[outer[j]])));
+        double sum= _mm_cvtsd_f64(_mm_add_sd(acc, _mm_unpackhi_pd(acc, acc)));
+        for(; j<end; ++j)
+            sum+= values[j]*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+//float, 4 lanes
+template <class I>
+__attribute__((target("sse2")))
+inline void csrRowsSse2(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                        const float *values, const float *x, float *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m128 acc= _mm_setzero_ps();
+        for(; j+4<=end; j+=4)
+            acc= _mm_add_ps(acc, _mm_mul_ps(_mm_loadu_ps(values+j),
+                            _mm_set_ps(x[outer[j+3]], x[outer[j+2]], x[outer[j+1]], x[outer[j]])));
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, acc);
+        float sum= (lanes[0]+lanes[1])+(lanes[2]+lanes[3]);
+        for(; j<end; ++j)
+            sum+= values[j]*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+//double, 4 lanes, gather with 64-bit indexes
+template <class I>
+__attribute__((target("avx2,fma")))
+inline void csrRowsAvx2(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                        const double *values, const double *x, double *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m256d acc= _mm256_setzero_pd();
+        for(; j+4<=end; j+=4)
+            acc= _mm256_fmadd_pd(_mm256_loadu_pd(values+j), _mm256_i64gather_pd(x, loadIndexes4(outer+j), 8), acc);
+        __m128d half= _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        double sum= _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for(; j<end; ++j)
+            sum+= values[j]*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+//float, 4 lanes (4 indexes of 64 bits fill a 256-bit register)
+template <class I>
+__attribute__((target("avx2,fma")))
+inline void csrRowsAvx2(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                        const float *values, const float *x, float *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m128 acc= _mm_setzero_ps();
+        for(; j+4<=end; j+=4)
+            acc= _mm_fmadd_ps(_mm_loadu_ps(values+j), _mm256_i64gather_ps(x, loadIndexes4(outer+j), 4), acc);
+        acc= _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+        float sum= _mm_cvtss_f32(_mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1)));
+        for(; j<end; ++j)
+            sum+= values[j]*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+//double, 8 lanes, the remainder of the row is handled with masks
+//(masked gathers with a zero source avoid reading undefined registers)
+template <class I>
+__attribute__((target("avx512f")))
+inline void csrRowsAvx512(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                          const double *values, const double *x, double *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m512d acc= _mm512_setzero_pd();
+        for(; j+8<=end; j+=8){
+            __m512i idx= loadIndexes8(0xFF, outer+j);
+            acc= _mm512_fmadd_pd(_mm512_loadu_pd(values+j), _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, idx, x, 8), acc);
+        }
+        if(j<end){
+            __mmask8 mask= static_cast<__mmask8>((1u<<(end-j))-1);
+            __m512i idx= loadIndexes8(mask, outer+j);
+            __m512d xv= _mm512_mask_i64gather_pd(_mm512_setzero_pd(), mask, idx, x, 8);
+            acc= _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, values+j), xv, acc);
+        }
+        alignas(64) double lanes[8];
+        _mm512_store_pd(lanes, acc);
+        y[i]= ((lanes[0]+lanes[4])+(lanes[1]+lanes[5]))+((lanes[2]+lanes[6])+(lanes[3]+lanes[7]));
+    }
+};
+
+//float, 8 lanes (8 indexes of 64 bits fill a 512-bit register)
+template <class I>
+__attribute__((target("avx512f")))
+inline void csrRowsAvx512(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                          const float *values, const float *x, float *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m512 acc= _mm512_setzero_ps();
+        for(; j+8<=end; j+=8){
+            __m512i idx= loadIndexes8(0xFF, outer+j);
+            __m512 xv= _mm512_castps256_ps512(_mm512_mask_i64gather_ps(_mm256_setzero_ps(), 0xFF, idx, x, 4));
+            __m512 vv= _mm512_castps256_ps512(_mm256_loadu_ps(values+j));
+            acc= _mm512_maskz_fmadd_ps(0xFF, vv, xv, acc);
+        }
+        if(j<end){
+            __mmask8 mask= static_cast<__mmask8>((1u<<(end-j))-1);
+            __m512i idx= loadIndexes8(mask, outer+j);
+            __m512 xv= _mm512_castps256_ps512(_mm512_mask_i64gather_ps(_mm256_setzero_ps(), mask, idx, x, 4));
+            __m512 vv= _mm512_maskz_loadu_ps(mask, values+j);
+            acc= _mm512_maskz_fmadd_ps(0xFF, vv, xv, acc);
+        }
+        alignas(64) float lanes[16];
+        _mm512_store_ps(lanes, acc);
+        y[i]= ((lanes[0]+lanes[4])+(lanes[1]+lanes[5]))+((lanes[2]+lanes[6])+(lanes[3]+lanes[7]));
+    }
+};
+
+//4 values widened to double, a bfloat16 is the upper half of a float
+template <class V>
+__attribute__((target("avx2")))
+inline __m256d loadWidened4(const V *p){
+    if constexpr (std::is_same_v<V,float>)
+        return _mm256_cvtps_pd(_mm_loadu_ps(p));
+    else{
+        __m128i h= _mm_cvtepu16_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(p)));
+        return _mm256_cvtps_pd(_mm_castsi128_ps(_mm_slli_epi32(h, 16)));
+    }
+};
+
+//8 values widened to double
+//(the zero-masked conversion avoids reading an undefined register, as the gathers)
+template <class V>
+__attribute__((target("avx512f")))
+inline __m512d loadWidened8(const V *p){
+    if constexpr (std::is_same_v<V,float>)
+        return _mm512_maskz_cvtps_pd(0xFF, _mm256_loadu_ps(p));
+    else{
+        __m256i h= _mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        return _mm512_maskz_cvtps_pd(0xFF, _mm256_castsi256_ps(_mm256_slli_epi32(h, 16)));
+    }
+};
+
+//float or bfloat16 values, double vectors, 4 lanes
+template <class V, class I>
+__attribute__((target("avx2,fma")))
+inline void csrRowsWidenAvx2(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                             const V *values, const double *x, double *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m256d acc= _mm256_setzero_pd();
+        for(; j+4<=end; j+=4)
+            acc= _mm256_fmadd_pd(loadWidened4(values+j), _mm256_i64gather_pd(x, loadIndexes4(outer+j), 8), acc);
+        __m128d half= _mm_add_pd(_mm256_castpd256_pd128(acc), _mm256_extractf128_pd(acc, 1));
+        double sum= _mm_cvtsd_f64(_mm_add_sd(half, _mm_unpackhi_pd(half, half)));
+        for(; j<end; ++j)
+            sum+= static_cast<double>(values[j])*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+//float or bfloat16 values, double vectors, 8 lanes, the remainder of the row is scalar
+template <class V, class I>
+__attribute__((target("avx512f")))
+inline void csrRowsWidenAvx512(std::size_t first, std::size_t last, const I *inner, const I *outer,
+                               const V *values, const double *x, double *y){
+    for(std::size_t i=first; i<last; ++i){
+        std::size_t j=inner[i], end=inner[i+1];
+        __m512d acc= _mm512_setzero_pd();
+        for(; j+8<=end; j+=8){
+            __m512i idx= loadIndexes8(0xFF, outer+j);
+            acc= _mm512_fmadd_pd(loadWidened8(values+j), _mm512_mask_i64gather_pd(_mm512_setzero_pd(), 0xFF, idx, x, 8), acc);
+        }
+        alignas(64) double lanes[8];
+        _mm512_store_pd(lanes, acc);
+        double sum= ((lanes[0]+lanes[4])+(lanes[1]+lanes[5]))+((lanes[2]+lanes[6])+(lanes[3]+lanes[7]));
+        for(; j<end; ++j)
+            sum+= static_cast<double>(values[j])*x[outer[j]];
+        y[i]= sum;
+    }
+};
+
+}
+
+#endif
+
+/**
+ * \brief Tells if T, with indexes of type I, has hand-written kernels
+ */
+template <class T, class I = std::size_t>
+inline constexpr bool hasKernel= ALGEBRA_X86_SIMD && (std::is_same_v<T,double> || std::is_same_v<T,float>) && isKernelIndex<I>;
+
+/**
+ * \brief Tells if values of type V multiplied by vectors of type T, with indexes of type I, have hand-written
+ *        kernels that widen the values (float or bfloat16 values, double vectors)
+ */
+template <class V, class T, class I = std::size_t>
+inline constexpr bool hasWidenKernel= ALGEBRA_X86_SIMD && std::is_same_v<T,double>
+                                      && (std::is_same_v<V,float> || std::is_same_v<V,bfloat16>) && isKernelIndex<I>;
+
+/**
+ * \brief CSR product of the rows [first, last) with the kernel of the active instruction set
+ *
+ * double and float use the hand-written kernels (AVX-512 or AVX2 gathers with FMA, SSE2 otherwise),
+ * the other types use csrRowsScalar. Values stored in float or bfloat16 with double vectors (mixed precision) use
+ * kernels that widen the values to double after loading them, with AVX-512 or AVX2.
+ * The results may differ from the scalar loop in the last bits, since the sums are done in a different order and
+ * with fused multiply-add.
+ * The kernels read 64-bit or 32-bit indexes; the 32-bit ones halve the memory traffic of m_outer and are
+ * zero-extended in registers before the gathers. Other index types use csrRowsScalar.
+ *
+ * \tparam V Type of the stored values
+ * \tparam T Type of the vectors and of the sums
+ * \tparam I Type of the indexes
+ * \param first First row
+ * \param last One past the last row
+ * \param inner m_inner of the matrix
+ * \param outer m_outer of the matrix
+ * \param values m_values of the matrix
+ * \param x The vector
+ * \param y The result, y[i] is overwritten for every row i in [first, last)
+ */
+template <class V, class T, class I>
+void csrRows(std::size_t first, std::size_t last, const I *inner, const I *outer,
+             const V *values, const T *x, T *y){
+#if ALGEBRA_X86_SIMD
+    if constexpr (hasWidenKernel<V,T,I>){
+        switch(activeIsa()){
+            case avx512: return detail::csrRowsWidenAvx512(first, last, inner, outer, values, x, y);
+            case avx2:   return detail::csrRowsWidenAvx2(first, last, inner, outer, values, x, y);
+            default:     break;
+        }
+    }
+    if constexpr (std::is_same_v<V,T> && hasKernel<T,I>){
+        switch(activeIsa()){
+            case avx512: return detail::csrRowsAvx512(first, last, inner, outer, values, x, y);
+            case avx2:   return detail::csrRowsAvx2(first, last, inner, outer, values, x, y);
+            case sse2:   return detail::csrRowsSse2(first, last, inner, outer, values, x, y);
+            default:     break;
+        }
+    }
+#endif
+    csrRowsScalar(first, last, inner, outer, values, x, y);
+};
+
+}
+
+};
+
+
+#endif /*SIMDKERNELS_HPP*/
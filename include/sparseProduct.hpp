@@ -0,0 +1,289 @@
+#ifndef SPARSEPRODUCT_HPP
+#define SPARSEPRODUCT_HPP
+
+/**
+ * \file sparseProduct.hpp
+ * \brief Product of two sparse matrices (SpGEMM), in parallel, with a symbolic and a numeric pass
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "threadUtilities.hpp"
+#include "transpose.hpp"
+#include "instrumentation.hpp"
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <limits>
+#include <span>
+#include <vector>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Accumulator of one row (column) of a sparse product, owned by one thread
+ *
+ * A row whose number of products is at least 1/dense_ratio of its length is accumulated in dense arrays as long as
+ * the row, marked with the number of the row so that they are never cleared; a shorter row in an open-addressing
+ * hash table with twice as many slots as products, so that its cost does not depend on the length of the row.
+ *
+ * \tparam U Type of the elements
+ * \tparam I Type of the indexes
+ */
+template <class U, class I>
+class RowAccumulator{
+
+public:
+
+    static constexpr std::size_t dense_ratio= 8;
+
+    /**
+     * \param n Length of the rows (columns) of the product
+     */
+    explicit RowAccumulator(std::size_t n): m_n(n) {};
+
+    /**
+     * \brief Starts a row
+     * \param bound Number of products of the row, an upper bound of its elements
+     */
+    void start(std::size_t bound){
+        m_indexes.clear();
+        m_slots.clear();
+        m_dense= bound*dense_ratio>=m_n;
+        if(m_dense){
+            //the dense arrays are allocated by the first dense row
+            if(m_marks.empty()){
+                m_marks.assign(m_n, 0);
+                m_dense_values.resize(m_n);
+            }
+            ++m_row;
+        }
+        else{
+            std::size_t capacity= std::bit_ceil(2*bound+1);
+            if(m_keys.size()<capacity){
+                m_keys.assign(capacity, empty);
+                m_hash_values.resize(capacity);
+            }
+            m_mask= capacity-1;
+        }
+    };
+
+    /**
+     * \brief Adds a product to the row
+     * \tparam numeric false for the symbolic pass, which only collects the indexes
+     * \param index The index of the product inside the row
+     * \param value The product
+     */
+    template <bool numeric>
+    void add(I index, const U &value){
+        if(m_dense){
+            if(m_marks[index]!=m_row){
+                m_marks[index]= m_row;
+                m_indexes.push_back(index);
+                if constexpr (numeric)
+                    m_dense_values[index]= value;
+            }
+            else if constexpr (numeric)
+                m_dense_values[index]+= value;
+        }
+        else{
+            std::size_t slot= find(index);
+            if(m_keys[slot]==empty){
+                m_keys[slot]= index;
+                m_indexes.push_back(index);
+                m_slots.push_back(slot);
+                if constexpr (numeric)
+                    m_hash_values[slot]= value;
+            }
+            else if constexpr (numeric)
+                m_hash_values[slot]+= value;
+        }
+    };
+
+    /**
+     * \brief Number of elements of the row
+     */
+    std::size_t size() const {return m_indexes.size();};
+
+    /**
+     * \brief Ends the row, optionally writing its elements in increasing index order
+     * \tparam numeric false for the symbolic pass, which writes nothing
+     * \param outer Where the indexes are written
+     * \param values Where the values are written
+     */
+    template <bool numeric>
+    void finish(I *outer, U *values){
+        if constexpr (numeric){
+            std::sort(m_indexes.begin(), m_indexes.end());
+            for(std::size_t k=0; k<m_indexes.size(); ++k){
+                outer[k]= m_indexes[k];
+                values[k]= m_dense ? m_dense_values[m_indexes[k]] : m_hash_values[find(m_indexes[k])];
+            }
+        }
+        //the slots are emptied for the next row, after the lookups, which follow the probe sequences
+        for(std::size_t slot: m_slots)
+            m_keys[slot]= empty;
+    };
+
+private:
+
+    static constexpr I empty= std::numeric_limits<I>::max();
+
+    //slot of index, or the empty slot where it goes (linear probing)
+    std::size_t find(I index) const{
+        std::size_t slot= static_cast<std::size_t>((static_cast<std::uint64_t>(index)*0x9E3779B97F4A7C15ull)>>32) & m_mask;
+        while(m_keys[slot]!=empty && m_keys[slot]!=index)
+            slot= (slot+1) & m_mask;
+        return slot;
+    };
+
+    std::size_t m_n;
+    bool m_dense=false;
+    std::vector<I> m_indexes;
+    std::vector<std::size_t> m_slots;
+
+    std::size_t m_row=0;
+    std::vector<std::size_t> m_marks;
+    std::vector<U> m_dense_values;
+
+    std::size_t m_mask=0;
+    std::vector<I> m_keys;
+    std::vector<U> m_hash_values;
+
+};
+
+/**
+ * \brief Accumulates row (column) i of the product of two compressed matrices with the same storage order
+ * \tparam numeric false for the symbolic pass
+ */
+template <bool numeric, class U, class I>
+void accumulateRow(RowAccumulator<U,I> &accumulator, std::size_t i, std::size_t bound,
+                   std::span<const I> l_inner, std::span<const I> l_outer, std::span<const U> l_values,
+                   std::span<const I> r_inner, std::span<const I> r_outer, std::span<const U> r_values){
+    accumulator.start(bound);
+    for(std::size_t j=l_inner[i]; j<l_inner[i+1]; ++j){
+        std::size_t k= l_outer[j];
+        for(std::size_t h=r_inner[k]; h<r_inner[k+1]; ++h)
+            accumulator.template add<numeric>(r_outer[h], numeric ? l_values[j]*r_values[h] : U());
+    }
+};
+
+}
+
+/**
+ * @brief Performs the product between two sparse matrices (SpGEMM) with Gustavson's algorithm, in parallel.
+ *
+ * The result has the storage order of a. A CSR product is computed row by row, row i of a*b being the sum of the
+ * rows k of b scaled by a(i,k); a CSC product column by column, column j being the sum of the columns k of a scaled
+ * by b(k,j). So b is converted to the storage order of a first (see changeStorageOrder) if it differs.
+ * The rows (columns) of the result are split among the threads by their number of products; a symbolic pass counts
+ * the elements of every row, which gives m_inner, then a numeric pass computes them and writes them in place in
+ * m_outer and m_values, sorted. Every thread has its own accumulator, dense or hash (see detail::RowAccumulator).
+ * The elements that cancel out are stored.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of a and of the result.
+ * @tparam t The storage order of b.
+ * @tparam I The index type of the matrices.
+ * @tparam A The assembly backend of the matrices.
+ * @param a The left sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @param b The right sparse matrix, the same.
+ * @param n_threads The number of threads, 0 means one per hardware thread.
+ * @return The compressed product, empty if the dimensions are incompatible or it does not fit in the index type.
+ */
+template<class U, StorageOrder s, StorageOrder t, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> sparseProduct(const SparseMatrix<U,s,I,A> &a, const SparseMatrix<U,t,I,A> &b, std::size_t n_threads){
+    if(a.m_cols!=b.m_rows){
+        std::cerr << "Dimensions are incompatible\n";
+        return SparseMatrix<U,s,I,A>(0,0);
+    }
+    if constexpr (s!=t)
+        return sparseProduct(a, changeStorageOrder(b), n_threads);
+    else{
+        if(!a.m_compressed || !a.m_pending.empty() || !b.m_compressed || !b.m_pending.empty()){
+            SparseMatrix<U,s,I,A> a_copy(a), b_copy(b);
+            a_copy.compress();
+            b_copy.compress();
+            if(!a_copy.is_compressed() || a_copy.pending() || !b_copy.is_compressed() || b_copy.pending()) //too many elements for the index type
+                return SparseMatrix<U,s,I,A>(0,0);
+            return sparseProduct(a_copy, b_copy, n_threads);
+        }
+        ALGEBRA_TIME(sparseProduct);
+
+        //CSR: rows of a times rows of b; CSC: columns of b times columns of a
+        const SparseMatrix<U,s,I,A> &left= IsRowWise<s>::value ? a : b;
+        const SparseMatrix<U,s,I,A> &right= IsRowWise<s>::value ? b : a;
+        std::span<const I> l_inner(left.m_inner), l_outer(left.m_outer), r_inner(right.m_inner), r_outer(right.m_outer);
+        std::span<const U> l_values(left.m_values), r_values(right.m_values);
+        std::size_t n= l_inner.size()-1;
+        std::size_t n_minor= IsRowWise<s>::value ? b.m_cols : a.m_rows;
+
+        //products of every row/column, prefix summed, for balancing the threads
+        std::vector<std::size_t> products(n+1, 0);
+        for(std::size_t i=0; i<n; ++i){
+            std::size_t count=0;
+            for(std::size_t j=l_inner[i]; j<l_inner[i+1]; ++j)
+                count+= r_inner[l_outer[j]+1]-r_inner[l_outer[j]];
+            products[i+1]= products[i]+count;
+        }
+        n_threads= std::min(detail::threadCount(n_threads), std::max<std::size_t>(n, 1));
+        std::vector<std::size_t> bounds= detail::partitionByNnz(products, n_threads);
+        std::vector<detail::RowAccumulator<U,I>> accumulators(n_threads, detail::RowAccumulator<U,I>(n_minor));
+
+        //symbolic pass: number of elements of every row/column
+        std::vector<std::size_t> counts(n+1, 0);
+        detail::runChunks(bounds, [&](std::size_t p, std::size_t first, std::size_t last){
+            for(std::size_t i=first; i<last; ++i){
+                detail::accumulateRow<false>(accumulators[p], i, products[i+1]-products[i], l_inner, l_outer, l_values, r_inner, r_outer, r_values);
+                counts[i+1]= accumulators[p].size();
+                accumulators[p].template finish<false>(nullptr, nullptr);
+            }
+        });
+        for(std::size_t i=0; i<n; ++i)
+            counts[i+1]+= counts[i];
+        if(!fitsIndex<I>(a.m_rows, b.m_cols, counts[n])){
+            std::cerr << "The number of non-zero elements does not fit in the index type\n";
+            return SparseMatrix<U,s,I,A>(0,0);
+        }
+
+        SparseMatrix<U,s,I,A> res(a.m_rows, b.m_cols);
+        res.m_inner.assign(counts.begin(), counts.end());
+        res.m_outer.resize(counts[n]);
+        res.m_values.resize(counts[n]);
+        res.m_compressed= true;
+        ALGEBRA_VOLUME(sparseProduct, (left.m_values.size()+products[n]+counts[n])*(sizeof(I)+sizeof(U)), products[n]);
+
+        //numeric pass: every row/column is written in its own range
+        detail::runChunks(bounds, [&](std::size_t p, std::size_t first, std::size_t last){
+            for(std::size_t i=first; i<last; ++i){
+                detail::accumulateRow<true>(accumulators[p], i, products[i+1]-products[i], l_inner, l_outer, l_values, r_inner, r_outer, r_values);
+                accumulators[p].template finish<true>(res.m_outer.data()+counts[i], res.m_values.data()+counts[i]);
+            }
+        });
+        return res;
+    }
+};
+
+/**
+ * @brief Performs the product between two sparse matrices, see sparseProduct.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of a and of the result.
+ * @tparam t The storage order of b.
+ * @tparam I The index type of the matrices.
+ * @tparam A The assembly backend of the matrices.
+ * @param a The left sparse matrix.
+ * @param b The right sparse matrix.
+ * @return The compressed product, with one thread per hardware thread.
+ */
+template<class U, StorageOrder s, StorageOrder t, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,s,I,A> operator*(const SparseMatrix<U,s,I,A> &a, const SparseMatrix<U,t,I,A> &b){
+    return sparseProduct(a, b, 0);
+};
+
+};
+
+
+#endif /*SPARSEPRODUCT_HPP*/
@@ -0,0 +1,88 @@
+#ifndef THREADUTILITIES_HPP
+#define THREADUTILITIES_HPP
+
+/**
+ * \file threadUtilities.hpp
+ * \brief Helpers for splitting work among threads
+ */
+
+// clang-format off
+#include <algorithm>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+namespace algebra{
+
+namespace detail{
+
+/**
+ * \brief Number of threads to use, 0 means one per hardware thread
+ * \param requested Number of threads requested by the user
+ * \return Number of threads, at least 1
+ */
+inline std::size_t threadCount(std::size_t requested){
+    if(requested==0)
+        requested= std::thread::hardware_concurrency();
+    return std::max<std::size_t>(requested, 1);
+};
+
+/**
+ * \brief Splits the rows/columns described by a compressed inner vector into contiguous chunks with roughly the same number of non-zeros
+ * \tparam Inner Type of the inner vector (random access, sorted)
+ * \param inner The inner vector, of size n+1 for n rows/columns
+ * \param n_parts Number of chunks
+ * \return Vector of n_parts+1 boundaries, chunk p is [bounds[p], bounds[p+1])
+ */
+template<class Inner>
+std::vector<std::size_t> partitionByNnz(const Inner &inner, std::size_t n_parts){
+    std::size_t n= inner.size()-1;
+    std::size_t nnz= inner[n];
+    std::vector<std::size_t> bounds(n_parts+1, n);
+    bounds[0]=0;
+    //the first row/column whose starting offset reaches p/n_parts of the non-zeros opens chunk p
+    for(std::size_t p=1; p<n_parts; ++p){
+        std::size_t target= nnz*p/n_parts;
+        std::size_t b= std::lower_bound(inner.begin(), inner.end(), target) - inner.begin();
+        bounds[p]= std::clamp(b, bounds[p-1], n);
+    }
+    return bounds;
+};
+
+/**
+ * \brief Splits [0,n) into n_parts contiguous chunks of (almost) the same length
+ * \param n Length of the range
+ * \param n_parts Number of chunks
+ * \return Vector of n_parts+1 boundaries
+ */
+inline std::vector<std::size_t> partitionEvenly(std::size_t n, std::size_t n_parts){
+    std::vector<std::size_t> bounds(n_parts+1);
+    for(std::size_t p=0; p<=n_parts; ++p)
+        bounds[p]= n*p/n_parts;
+    return bounds;
+};
+
+/**
+ * \brief Runs work(p, bounds[p], bounds[p+1]) for every chunk p, one chunk per thread
+ * \tparam Work Callable taking (chunk index, begin, end)
+ * \param bounds Chunk boundaries
+ * \param work The work to do on every chunk
+ * \note The first chunk is processed by the calling thread
+ */
+template<class Work>
+void runChunks(const std::vector<std::size_t> &bounds, Work &&work){
+    std::vector<std::thread> workers;
+    workers.reserve(bounds.size()-1);
+    for(std::size_t p=1; p+1<bounds.size(); ++p)
+        workers.emplace_back([&work, &bounds, p](){ work(p, bounds[p], bounds[p+1]); });
+    work(0, bounds[0], bounds[1]);
+    for(auto &w: workers)
+        w.join();
+};
+
+}
+
+};
+
+
+#endif /*THREADUTILITIES_HPP*/
@@ -0,0 +1,123 @@
+#ifndef TRANSPOSE_HPP
+#define TRANSPOSE_HPP
+
+/**
+ * \file transpose.hpp
+ * \brief Product with the transpose, transpose and change of storage order of a SparseMatrix
+ */
+
+// clang-format off
+#include "SparseMatrix.hpp"
+#include "gemv.hpp"
+#include <vector>
+
+namespace algebra{
+
+/**
+ * @brief Performs the product between the transpose of the sparse matrix and a vector.
+ *
+ * The transpose is not built: the compressed vectors are read as they are, the CSR matrix scatters and the CSC
+ * matrix gathers (see gemv).
+ *
+ * @tparam U The type of the matrix and vector elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix.
+ * @param v The vector, of size m.rows().
+ * @return The resulting vector A^T*v, of size m.cols().
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+std::vector<U> transposeProduct(const SparseMatrix<U,s,I,A> &m, const std::vector<U> &v){
+    if(m.rows()!=v.size()){
+        std::cerr << "Dimensions are incompatible\n";
+        return std::vector<U>();
+    }
+    std::vector<U> res(m.cols());
+    gemv(U(1), m, v, U(0), res, true);
+    return res;
+};
+
+/**
+ * @brief Builds the transpose of the sparse matrix.
+ *
+ * The CSR vectors of a matrix are the CSC vectors of its transpose (and vice versa), so the result has the opposite
+ * storage order and the same m_inner, m_outer and m_values, copied without any sorting.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @return The compressed transpose, with the opposite storage order.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,OppositeOrder<s>::value,I,A> transpose(const SparseMatrix<U,s,I,A> &m){
+    if(!m.m_compressed || !m.m_pending.empty()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return SparseMatrix<U,OppositeOrder<s>::value,I,A>(0,0);
+        return transpose(copy);
+    }
+    SparseMatrix<U,OppositeOrder<s>::value,I,A> t(m.m_cols, m.m_rows);
+    t.m_inner= m.m_inner;
+    t.m_outer= m.m_outer;
+    t.m_values= m.m_values;
+    t.m_compressed= true;
+    return t;
+};
+
+/**
+ * @brief Converts the sparse matrix to the opposite storage order (CSR to CSC or CSC to CSR).
+ *
+ * The conversion is a counting sort in O(nnz): the elements are counted by their outer index, which gives the new
+ * m_inner, then they are scattered following the old order, so that every new row (column) is already sorted.
+ *
+ * @tparam U The type of the matrix elements.
+ * @tparam s The storage order of the matrix (row-wise or column-wise).
+ * @tparam I The index type of the matrix.
+ * @tparam A The assembly backend of the matrix.
+ * @param m The sparse matrix, if it is uncompressed or has pending insertions a compressed copy is used.
+ * @return The same matrix, compressed with the opposite storage order.
+ */
+template<class U, StorageOrder s, class I, template<class,StorageOrder,class> class A>
+SparseMatrix<U,OppositeOrder<s>::value,I,A> changeStorageOrder(const SparseMatrix<U,s,I,A> &m){
+    if(!m.m_compressed || !m.m_pending.empty()){
+        SparseMatrix<U,s,I,A> copy(m);
+        copy.compress();
+        if(!copy.is_compressed() || copy.pending()) //too many elements for the index type
+            return SparseMatrix<U,OppositeOrder<s>::value,I,A>(0,0);
+        return changeStorageOrder(copy);
+    }
+
+    SparseMatrix<U,OppositeOrder<s>::value,I,A> res(m.m_rows, m.m_cols);
+    std::size_t n_old= m.m_inner.size()-1;
+    std::size_t n_new= IsRowWise<s>::value ? m.m_cols : m.m_rows;
+    std::size_t nnz= m.m_values.size();
+
+    //count the elements of every new row/column, then prefix sum
+    res.m_inner.assign(n_new+1, 0);
+    for(std::size_t j=0; j<nnz; ++j)
+        ++res.m_inner[m.m_outer[j]+1];
+    for(std::size_t k=0; k<n_new; ++k)
+        res.m_inner[k+1]+= res.m_inner[k];
+
+    //scatter, next[k] is where the next element of row/column k goes
+    std::vector<std::size_t> next(res.m_inner.begin(), res.m_inner.end()-1);
+    res.m_outer.resize(nnz);
+    res.m_values.resize(nnz);
+    for(std::size_t i=0; i<n_old; ++i)
+        for(std::size_t j=m.m_inner[i]; j<m.m_inner[i+1]; ++j){
+            std::size_t pos= next[m.m_outer[j]]++;
+            res.m_outer[pos]= i;
+            res.m_values[pos]= m.m_values[j];
+        }
+    res.m_compressed= true;
+    return res;
+};
+
+};
+
+
+#endif /*TRANSPOSE_HPP*/
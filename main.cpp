@@ -1,12 +1,831 @@
 #include "SparseMatrix.hpp"
+#include "AssemblyArena.hpp"
+#include "MappedSparseMatrix.hpp"
+#include "StreamingSparseMatrix.hpp"
+#include "BlockSparseMatrix.hpp"
+#include "SellMatrix.hpp"
+#include "SymmetricSparseMatrix.hpp"
 #include "chrono.hpp"
 #include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cmath>
 #include <complex>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <numeric>
 #include <random>
 #include <ranges>
+#include <sstream>
+#include <string>
 
 using namespace algebra;
 
+namespace{
+
+//a failed check is printed and makes main return 1
+int failures= 0;
+
+void check(bool passed, const std::string &what){
+    if(passed)
+        std::cout << what << "\n";
+    else{
+        std::cout << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+//references to the elements of an uncompressed matrix stay valid in a copy while new elements are inserted,
+//with the keys in order (sorted run of the backend) and in reverse order (map or hash table)
+template <template<class,StorageOrder,class> class Assembly>
+bool referencesSurviveCopy(){
+    bool valid= true;
+    for(bool sorted: {true, false}){
+        SparseMatrix<double,StorageOrder::row_wise,std::size_t,Assembly> a(100,100);
+        for(std::size_t i=0; i<20; ++i)
+            a(sorted ? i : 19-i, 0)= i;
+        SparseMatrix<double,StorageOrder::row_wise,std::size_t,Assembly> b(a);
+        double &r= b(17,0);
+        for(std::size_t i=20; i<60; ++i)
+            b(i,0)= i;
+        r= -1.;
+        valid= valid && std::as_const(b)(17,0)==-1. && std::as_const(a)(17,0)==(sorted ? 17. : 2.);
+    }
+    return valid;
+}
+
+//dense copy of a matrix, read with the constant call operator
+template <class Matrix>
+std::vector<std::vector<double>> dense(const Matrix &m){
+    std::vector<std::vector<double>> res(m.rows(), std::vector<double>(m.cols()));
+    for(std::size_t i=0; i<m.rows(); ++i)
+        for(std::size_t j=0; j<m.cols(); ++j)
+            res[i][j]= m(i,j);
+    return res;
+}
+
+std::vector<double> denseProduct(const std::vector<std::vector<double>> &a, const std::vector<double> &x){
+    std::vector<double> res(a.size());
+    for(std::size_t i=0; i<a.size(); ++i)
+        for(std::size_t j=0; j<x.size(); ++j)
+            res[i]+= a[i][j]*x[j];
+    return res;
+}
+
+//a and b have the same size and differ by at most tol, relative to the size of the elements of b
+bool near(const std::vector<double> &a, const std::vector<double> &b, double tol=1e-12){
+    if(a.size()!=b.size())
+        return false;
+    for(std::size_t i=0; i<a.size(); ++i)
+        if(!(std::abs(a[i]-b[i]) <= tol*std::max(1.,std::abs(b[i]))))
+            return false;
+    return true;
+}
+
+std::vector<double> randomValues(std::size_t n, std::mt19937 &gen){
+    std::vector<double> res(n);
+    std::ranges::generate(res, [&]() { return std::uniform_real_distribution<double>(-1., 1.)(gen); });
+    return res;
+}
+
+//n triplets in [0,rows)x[0,cols), with repeated positions since they are drawn independently
+std::vector<Triplet<double>> randomTriplets(std::size_t rows, std::size_t cols, std::size_t n, std::mt19937 &gen){
+    std::vector<Triplet<double>> res(n);
+    for(auto &t: res)
+        t= {std::uniform_int_distribution<std::size_t>(0, rows-1)(gen), std::uniform_int_distribution<std::size_t>(0, cols-1)(gen),
+            std::uniform_real_distribution<double>(-1., 1.)(gen)};
+    return res;
+}
+
+//references to the elements of an uncompressed matrix stay valid when the matrix is moved into another one, and the
+//elements are copied when the target uses another memory resource
+template <template<class,StorageOrder,class> class Assembly>
+bool referencesSurviveMove(){
+    std::pmr::monotonic_buffer_resource other;
+    SparseMatrix<double,StorageOrder::row_wise,std::size_t,Assembly> a(100,100), b(10,10), c(10,10,&other);
+    for(std::size_t i=0; i<20; ++i)
+        a(19-i, i)= i;
+    double *r= &a(17,2);
+    c= std::move(SparseMatrix<double,StorageOrder::row_wise,std::size_t,Assembly>(a));
+    b= std::move(a);
+    *r= -1.;
+    return &b(17,2)==r && std::as_const(b)(17,2)==-1. && std::as_const(c)(17,2)==2.;
+}
+
+//a matrix assembled in an AssemblyArena gives all its allocations back when compressed, so that the arena can be
+//released under the compressed matrix, which is the same as the one assembled on the default resource
+template <template<class,StorageOrder,class> class Assembly>
+bool checkAssemblyArena(){
+    std::mt19937 gen(15);
+    const auto triplets= randomTriplets(200, 150, 3000, gen);
+    AssemblyArena arena(1<<10);
+    SparseMatrix<double,StorageOrder::row_wise,std::size_t,Assembly> a(200, 150, &arena), b(200, 150);
+    for(const auto &t: triplets){
+        a(t.row, t.col)+= t.value;
+        b(t.row, t.col)+= t.value;
+    }
+    const bool used= arena.liveAllocations()>0;
+    a.compress();
+    b.compress();
+    return used && arena.liveAllocations()==0 && arena.release() && dense(a)==dense(b);
+}
+
+//setFromTriplets: repeated entries reduced in the order of the buffer, entries out of range skipped, same result on
+//one and several threads, and an empty matrix if the entries do not fit in the index type
+template <StorageOrder s>
+bool checkSetFromTriplets(){
+    std::mt19937 gen(3);
+    std::size_t rows= 40, cols= 30;
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 2000, gen);
+    std::vector<std::vector<double>> sum(rows, std::vector<double>(cols)), last= sum;
+    for(const auto &t: triplets){
+        sum[t.row][t.col]+= t.value;
+        last[t.row][t.col]= t.value;
+    }
+    //skipped, with a message on the standard error
+    triplets.push_back({rows, 0, 1.});
+    triplets.push_back({0, cols+5, 1.});
+
+    bool valid= true;
+    for(std::size_t n_threads: {1, 4}){
+        SparseMatrix<double,s> a(rows, cols), b(rows, cols);
+        a.setFromTriplets(std::span<const Triplet<double>>(triplets), std::plus<double>(), n_threads);
+        b.setFromTriplets(std::span<const Triplet<double>>(triplets), [](double, double repeated){ return repeated; }, n_threads);
+        std::vector<std::vector<double>> dense_a= dense(a), dense_b= dense(b);
+        valid= valid && a.is_compressed() && a.pending()==0;
+        for(std::size_t i=0; i<rows; ++i)
+            valid= valid && near(dense_a[i], sum[i]) && dense_b[i]==last[i];
+    }
+
+    //2000 entries do not fit in 8 bits, the previous content and the pending insertion are discarded
+    SparseMatrix<double,s,std::uint8_t> small(rows, cols);
+    small(1,1)= 1.;
+    small.compress();
+    small(2,2)= 2.;
+    small.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    valid= valid && !small.is_compressed() && small.pending()==0 && small.inner().empty() && small.values().empty()
+        && std::as_const(small)(1,1)==0. && std::as_const(small)(2,2)==0.;
+    return valid;
+}
+
+//insertions into a compressed matrix are staged, read by the call operator, the products and operator<<, and merged
+//by finalize
+template <StorageOrder s, template<class,StorageOrder,class> class Assembly>
+bool checkPendingInsertions(){
+    std::mt19937 gen(4);
+    std::size_t rows= 50, cols= 35;
+    SparseMatrix<double,s,std::size_t,Assembly> m(rows, cols);
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 300, gen);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<std::vector<double>> reference= dense(m);
+    std::size_t nnz= m.values().size();
+
+    //new elements and changes of stored ones, some new elements written twice
+    std::size_t n_new= 0;
+    for(const auto &t: randomTriplets(rows, cols, 200, gen)){
+        n_new+= reference[t.row][t.col]==0.;
+        reference[t.row][t.col]+= t.value;
+        m(t.row, t.col)+= t.value;
+    }
+    std::vector<double> x= randomValues(cols, gen);
+    std::vector<double> y= denseProduct(reference, x);
+    bool valid= m.is_compressed() && m.pending()==n_new && m.values().size()==nnz && dense(m)==reference
+                && near(m*x, y) && near(parallelProduct(m, x, 3), y);
+    //the pending insertions are printed to the stream, after the compressed vectors
+    std::ostringstream printed;
+    printed << m;
+    valid= valid && printed.str().find("Pending:")!=std::string::npos;
+
+    m.finalize();
+    valid= valid && m.pending()==0 && m.values().size()==nnz+n_new && dense(m)==reference && near(m*x, y);
+    //the rows (columns) stay sorted after the merge
+    for(std::size_t k=0; k+1<m.inner().size(); ++k)
+        valid= valid && std::is_sorted(m.outer().begin()+m.inner()[k], m.outer().begin()+m.inner()[k+1]);
+
+    //compress() of a compressed matrix merges as well
+    m(rows-1, cols-1)+= 1.;
+    reference[rows-1][cols-1]+= 1.;
+    m.compress();
+    return valid && m.pending()==0 && dense(m)==reference;
+}
+
+//gemv: y = alpha*A*x + beta*y and the transpose, for compressed, uncompressed and views, with strided x and y;
+//with beta 0 y is only written, so the NaN it holds do not propagate
+template <StorageOrder s>
+bool checkGemv(){
+    std::mt19937 gen(5);
+    std::size_t rows= 45, cols= 28;
+    SparseMatrix<double,s> m(rows, cols);
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 250, gen);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<std::vector<double>> a= dense(m), at(cols, std::vector<double>(rows));
+    for(std::size_t i=0; i<rows; ++i)
+        for(std::size_t j=0; j<cols; ++j)
+            at[j][i]= a[i][j];
+    SparseMatrix<double,s> uncompressed(m);
+    uncompressed.uncompress();
+    SparseMatrixView<double,s> view= m;
+
+    bool valid= true;
+    for(bool transpose: {false, true}){
+        const auto &op= transpose ? at : a;
+        std::size_t n_in= transpose ? rows : cols, n_out= transpose ? cols : rows;
+        std::vector<double> x= randomValues(n_in, gen), y0= randomValues(n_out, gen);
+        std::vector<double> ax= denseProduct(op, x);
+        for(auto [alpha, beta]: {std::pair(1., 0.), std::pair(2.5, 0.), std::pair(-1., 1.), std::pair(0.5, -3.)}){
+            std::vector<double> expected(n_out);
+            for(std::size_t i=0; i<n_out; ++i)
+                expected[i]= alpha*ax[i] + beta*y0[i];
+            std::vector<double> start= beta==0. ? std::vector<double>(n_out, std::nan("")) : y0;
+            std::vector<double> y1= start, y2= start, y3= start;
+            gemv(alpha, m, x, beta, y1, transpose);
+            gemv(alpha, uncompressed, x, beta, y2, transpose);
+            gemv(alpha, view, x, beta, y3, transpose);
+            //every other element of x and y, the others must not be touched
+            std::vector<double> xs(2*n_in, 7.), ys(2*n_out, 7.);
+            for(std::size_t i=0; i<n_in; ++i)
+                xs[2*i]= x[i];
+            for(std::size_t i=0; i<n_out; ++i)
+                ys[2*i]= start[i];
+            gemv(alpha, m, StridedView<const double>(xs.data(), n_in, 2), beta, StridedView<double>(ys.data(), n_out, 2), transpose);
+            std::vector<double> y4(n_out);
+            bool untouched= true;
+            for(std::size_t i=0; i<n_out; ++i){
+                y4[i]= ys[2*i];
+                untouched= untouched && ys[2*i+1]==7.;
+            }
+            valid= valid && near(y1, expected) && near(y2, expected) && near(y3, expected) && near(y4, expected) && untouched;
+        }
+    }
+    return valid;
+}
+
+//block format with R x C blocks: product, element access and conversion back, with rows and columns that are not
+//multiples of the block size, so the last block row and column are only partly inside the matrix
+template <StorageOrder s, std::size_t R, std::size_t C>
+bool checkBlockSparse(){
+    std::mt19937 gen(6);
+    std::size_t rows= 37, cols= 29;
+    SparseMatrix<double,s> m(rows, cols);
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 200, gen);
+    //elements in the last row and column, inside the edge blocks
+    triplets.push_back({rows-1, cols-1, 2.});
+    triplets.push_back({rows-1, 0, -1.});
+    triplets.push_back({0, cols-1, 3.});
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<std::vector<double>> a= dense(m);
+    std::vector<double> x= randomValues(cols, gen);
+
+    BlockSparseMatrix<double,R,C> b(m);
+    SparseMatrix<double,StorageOrder::row_wise> back_rows= b.template toSparseMatrix<StorageOrder::row_wise>();
+    SparseMatrix<double,StorageOrder::column_wise> back_cols= b.template toSparseMatrix<StorageOrder::column_wise>();
+    bool valid= b.rows()==rows && b.cols()==cols && dense(b)==a && near(b*x, denseProduct(a, x))
+                && back_rows.values().size()==m.values().size() && dense(back_rows)==a && dense(back_cols)==a;
+
+    //the uncompressed matrix is compressed in a copy; a vector of the wrong size gives an empty result
+    m.uncompress();
+    BlockSparseMatrix<double,R,C> from_uncompressed(m);
+    return valid && dense(from_uncompressed)==a && (b*std::vector<double>(cols+1)).empty();
+}
+
+//SELL-C-sigma with chunks of 8 rows and sorting windows of 1 (original order), 8 and all the rows: product, element access
+//and padding, counted from the row lengths sorted as the format does, and products with infinite and NaN elements
+template <StorageOrder s>
+bool checkSell(){
+    std::mt19937 gen(7);
+    std::size_t rows= 45, cols= 30, chunk= 8;
+    //rows of very different lengths, so that sorting changes the padding
+    std::vector<Triplet<double>> triplets;
+    for(std::size_t i=0; i<rows; ++i)
+        for(std::size_t j=0; j<cols; j+= 1+i%7)
+            triplets.push_back({i, j, std::uniform_real_distribution<double>(-1., 1.)(gen)});
+    SparseMatrix<double,s> m(rows, cols);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<std::vector<double>> a= dense(m);
+    std::vector<double> x= randomValues(cols, gen), y= denseProduct(a, x);
+    std::size_t nnz= m.values().size();
+
+    bool valid= true;
+    std::size_t previous_stored= std::size_t(-1);
+    for(std::size_t sigma: {std::size_t(1), chunk, rows}){
+        SellMatrix<double,8> sell(m, sigma);
+        std::vector<std::size_t> lengths(rows);
+        for(std::size_t i=0; i<rows; ++i)
+            lengths[i]= std::ranges::count_if(a[i], [](double v){ return v!=0.; });
+        for(std::size_t w=0; w<rows; w+=sigma)
+            std::sort(lengths.begin()+w, lengths.begin()+std::min(w+sigma, rows), std::greater<>());
+        std::size_t stored= 0;
+        for(std::size_t c=0; c<rows; c+=chunk)
+            stored+= chunk**std::max_element(lengths.begin()+c, lengths.begin()+std::min(c+chunk, rows));
+        //with these row lengths, larger windows group rows of closer length and need less padding
+        valid= valid && sell.rows()==rows && sell.cols()==cols && dense(sell)==a && near(sell*x, y)
+               && sell.storedElements()==stored && sell.paddingOverhead()==double(stored-nnz)/nnz && stored<=previous_stored;
+        previous_stored= stored;
+    }
+
+    //rows of the same length filling whole chunks need no padding
+    SparseMatrix<double,s> band(16, 16);
+    for(std::size_t i=0; i<16; ++i){
+        band(i, i)= 2.;
+        band(i, (i+1)%16)= -1.;
+    }
+    SellMatrix<double,8> sell_band(band);
+    valid= valid && sell_band.paddingOverhead()==0. && sell_band.storedElements()==32 && (sell_band*std::vector<double>(15)).empty();
+
+    //the padding and the lanes past the last row do not read x: an empty row stays 0 and a padded row keeps its value
+    //with infinite and NaN elements in x
+    SparseMatrix<double,s> sparse(10, 6);
+    sparse(0,0)= 1.;
+    sparse(2,5)= 1.;
+    for(std::size_t i: {1, 4, 6, 9})
+        for(std::size_t j=1; j<5; ++j)
+            sparse(i,j)= i+j;
+    sparse.compress();
+    std::vector<double> x_special= {std::numeric_limits<double>::infinity(), 1., 2., 3., 4., std::nan("")};
+    std::vector<std::vector<double>> b= dense(sparse);
+    for(std::size_t sigma: {std::size_t(1), std::size_t(10)}){
+        std::vector<double> product= SellMatrix<double,8>(sparse, sigma)*x_special;
+        for(std::size_t i=0; i<10; ++i){
+            double expected= 0.;
+            for(std::size_t j=0; j<6; ++j)
+                if(b[i][j]!=0.)
+                    expected+= b[i][j]*x_special[j];
+            valid= valid && (std::isnan(expected) ? std::isnan(product[i]) : product[i]==expected);
+        }
+    }
+    return valid;
+}
+
+//sparse product of an a_rows x n and an n x b_cols matrix in storage orders s and t, against the dense product: compressed,
+//with 32-bit indexes, with uncompressed operands, with pending insertions, and with operator*
+template <StorageOrder s, StorageOrder t>
+bool checkSparseProduct(){
+    std::mt19937 gen(8);
+    std::size_t a_rows= 33, n= 27, b_cols= 41;
+    SparseMatrix<double,s> a(a_rows, n);
+    SparseMatrix<double,t> b(n, b_cols);
+    std::vector<Triplet<double>> a_triplets= randomTriplets(a_rows, n, 120, gen), b_triplets= randomTriplets(n, b_cols, 150, gen);
+    a.setFromTriplets(std::span<const Triplet<double>>(a_triplets));
+    b.setFromTriplets(std::span<const Triplet<double>>(b_triplets));
+
+    auto expected= [&](){
+        std::vector<std::vector<double>> da= dense(a), db= dense(b), res(a_rows, std::vector<double>(b_cols));
+        for(std::size_t i=0; i<a_rows; ++i)
+            for(std::size_t k=0; k<n; ++k)
+                for(std::size_t j=0; j<b_cols; ++j)
+                    res[i][j]+= da[i][k]*db[k][j];
+        return res;
+    };
+    auto matches= [&](const auto &c, const std::vector<std::vector<double>> &reference){
+        bool valid= c.is_compressed() && c.pending()==0 && c.rows()==a_rows && c.cols()==b_cols;
+        std::vector<std::vector<double>> dc= dense(c);
+        for(std::size_t i=0; i<a_rows; ++i)
+            valid= valid && near(dc[i], reference[i]);
+        //sorted rows (columns)
+        for(std::size_t k=0; k+1<c.inner().size(); ++k)
+            valid= valid && std::is_sorted(c.outer().begin()+c.inner()[k], c.outer().begin()+c.inner()[k+1]);
+        return valid;
+    };
+
+    std::vector<std::vector<double>> reference= expected();
+    bool valid= matches(sparseProduct(a, b, 1), reference) && matches(sparseProduct(a, b, 3), reference) && matches(a*b, reference)
+                && matches(sparseProduct(changeIndexType<std::uint32_t>(a), changeIndexType<std::uint32_t>(b), 2), reference);
+
+    //uncompressed operands
+    SparseMatrix<double,s> a_uncompressed(a);
+    SparseMatrix<double,t> b_uncompressed(b);
+    a_uncompressed.uncompress();
+    b_uncompressed.uncompress();
+    valid= valid && matches(sparseProduct(a_uncompressed, b_uncompressed, 2), reference) && matches(a_uncompressed*b, reference);
+
+    //pending insertions in both operands
+    for(const auto &tr: randomTriplets(a_rows, n, 30, gen))
+        a(tr.row, tr.col)+= tr.value;
+    for(const auto &tr: randomTriplets(n, b_cols, 30, gen))
+        b(tr.row, tr.col)+= tr.value;
+    reference= expected();
+    valid= valid && a.pending()>0 && b.pending()>0 && matches(sparseProduct(a, b, 2), reference);
+
+    //incompatible dimensions give an empty matrix
+    SparseMatrix<double,s> c= sparseProduct(a, a, 1);
+    return valid && c.rows()==0 && c.cols()==0;
+}
+
+//reorder returns a permutation and its inverse, and the product of the permuted matrix with the permuted vector, brought back
+//to the old numbering, is the product of the matrix; permute rejects a vector that is not a permutation
+template <StorageOrder s>
+bool checkReorder(){
+    std::mt19937 gen(9);
+    std::size_t n= 60;
+    std::vector<Triplet<double>> triplets= randomTriplets(n, n, 240, gen);
+    //unsymmetric pattern and a row without elements
+    std::erase_if(triplets, [](const Triplet<double> &t){ return t.row==7; });
+    SparseMatrix<double,s> m(n, n);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<double> x= randomValues(n, gen), y= denseProduct(dense(m), x);
+
+    bool valid= true;
+    for(Ordering ordering: {Ordering::reverse_cuthill_mckee, Ordering::bisection}){
+        auto r= reorder(m, ordering, 4);
+        std::vector<std::size_t> sorted= r.permutation;
+        std::ranges::sort(sorted);
+        bool inverse= r.inverse.size()==n;
+        for(std::size_t k=0; inverse && k<n; ++k)
+            inverse= r.inverse[r.permutation[k]]==k;
+        valid= valid && sorted.size()==n && inverse && r.matrix.is_compressed() && r.matrix.values().size()==m.values().size();
+        for(std::size_t k=0; valid && k<n; ++k)
+            valid= sorted[k]==k;
+        valid= valid && near(unpermuteVector(r.matrix*permuteVector(x, r.permutation), r.permutation), y)
+               && near(unpermuteVector(parallelProduct(r.matrix, permuteVector(x, r.permutation), 3), r.permutation), y);
+    }
+
+    std::vector<std::size_t> repeated(n), out_of_range(n);
+    std::iota(repeated.begin(), repeated.end(), 0);
+    out_of_range= repeated;
+    repeated[5]= 6;
+    out_of_range[5]= n;
+    SparseMatrix<double,s> p1= permute(m, repeated), p2= permute(m, out_of_range);
+    return valid && p1.rows()==0 && p2.rows()==0;
+}
+
+//symmetric and skew-symmetric MatrixMarket files list one triangle: readMatrixMarket and readMatrixMarketMapped mirror it,
+//readSymmetricMatrixMarket keeps it in a SymmetricSparseMatrix, whose products and conversion match the full matrix
+template <StorageOrder s>
+bool checkSymmetric(){
+    std::mt19937 gen(10);
+    std::size_t n= 40;
+    //lower triangle with the diagonal, values exact in binary so that the file is read back exactly
+    std::vector<std::vector<double>> full(n, std::vector<double>(n)), skew= full;
+    std::vector<Triplet<double>> lower;
+    for(std::size_t i=0; i<n; ++i)
+        for(std::size_t j=0; j<=i; ++j)
+            if(i==j || std::uniform_int_distribution<int>(0, 5)(gen)==0){
+                double value= std::uniform_int_distribution<int>(-64, 64)(gen)/8.;
+                lower.push_back({i, j, value});
+                full[i][j]= full[j][i]= value;
+                if(i!=j){
+                    skew[i][j]= value;
+                    skew[j][i]= -value;
+                }
+            }
+    auto write= [&](const std::filesystem::path &file, const std::string &symmetry, bool diagonal){
+        std::ofstream out(file);
+        out << "%%MatrixMarket matrix coordinate real " << symmetry << "\n" << n << " " << n << " "
+            << std::ranges::count_if(lower, [&](const auto &t){ return diagonal || t.row!=t.col; }) << "\n";
+        for(const auto &t: lower)
+            if(diagonal || t.row!=t.col)
+                out << t.row+1 << " " << t.col+1 << " " << t.value << "\n";
+    };
+    std::filesystem::path symmetric_file= std::filesystem::temp_directory_path()/"algebra_symmetric.mtx";
+    std::filesystem::path skew_file= std::filesystem::temp_directory_path()/"algebra_skew.mtx";
+    write(symmetric_file, "symmetric", true);
+    //a skew-symmetric matrix has no diagonal
+    write(skew_file, "skew-symmetric", false);
+
+    const SparseMatrix<double,s> m= readMatrixMarket<double,s>(symmetric_file.string());
+    const SparseMatrix<double,s> mapped= readMatrixMarketMapped<double,s>(symmetric_file.string(), 2);
+    const SparseMatrix<double,s> m_skew= readMatrixMarket<double,s>(skew_file.string());
+    const SparseMatrix<double,s> mapped_skew= readMatrixMarketMapped<double,s>(skew_file.string(), 2);
+    bool valid= dense(m)==full && dense(mapped)==full && dense(m_skew)==skew && dense(mapped_skew)==skew;
+
+    std::vector<double> x= randomValues(n, gen), y= denseProduct(full, x);
+    const SymmetricSparseMatrix<double,s> from_file= readSymmetricMatrixMarket<double,s>(symmetric_file.string(), 2);
+    const SymmetricSparseMatrix<double,s> from_matrix(m);
+    for(const auto *sym: {&from_file, &from_matrix})
+        valid= valid && dense(*sym)==full && dense(sym->template toSparseMatrix<StorageOrder::row_wise>())==full
+               && dense(sym->template toSparseMatrix<StorageOrder::column_wise>())==full
+               && near(*sym*x, y) && near(parallelProduct(*sym, x, 3), y)
+               && sym->triangle().values().size()==lower.size();
+    //a skew-symmetric file is not read as a symmetric matrix
+    valid= valid && readSymmetricMatrixMarket<double,s>(skew_file.string()).rows()==0;
+
+    std::filesystem::remove(symmetric_file);
+    std::filesystem::remove(skew_file);
+    return valid;
+}
+
+//bfloat16 keeps the upper 16 bits of a float, rounded to nearest with ties to even; a NaN stays a NaN
+bool checkBfloat16Rounding(){
+    auto bf= [](float f){ return float(bfloat16(f)); };
+    return bf(1.f+1.f/256)==1.f && bf(1.f+3.f/256)==1.f+1.f/64 && bf(-(1.f+1.f/256))==-1.f && bf(1.f+1.f/256+1.f/4096)==1.f+1.f/128
+           && bf(3.140625f)==3.140625f && bf(3.14159265f)==3.140625f
+           && bf(std::numeric_limits<float>::infinity())==std::numeric_limits<float>::infinity()
+           && bf(std::numeric_limits<float>::max())==std::numeric_limits<float>::infinity()
+           && std::isnan(bf(std::numeric_limits<float>::quiet_NaN()))
+           //only the lowest bits of the mantissa set: the truncation alone would give infinity
+           && std::isnan(bf(std::bit_cast<float>(0x7F800001u)));
+}
+
+//products of the matrix with the values stored in V and the vector in double, accumulated in double: equal to the double
+//product of the rounded values, and within the precision of V of the product of the double values
+template <class V, StorageOrder s>
+bool checkMixedPrecision(double epsilon){
+    std::mt19937 gen(11);
+    std::size_t rows= 300, cols= 250;
+    SparseMatrix<double,s> m(rows, cols);
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 9000, gen);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<double> x= randomValues(cols, gen);
+    std::vector<std::vector<double>> a= dense(m), rounded= a;
+    for(auto &row: rounded)
+        for(double &v: row)
+            v= double(V(v));
+    std::vector<double> y= denseProduct(a, x), y_rounded= denseProduct(rounded, x);
+    //bound of the rounding error, relative to the sum of |a_ij*x_j|
+    std::vector<double> bound(rows);
+    for(std::size_t i=0; i<rows; ++i)
+        for(std::size_t j=0; j<cols; ++j)
+            bound[i]+= epsilon*std::abs(a[i][j]*x[j]);
+
+    const SparseMatrix<V,s> mv= castValues<V>(m);
+    SparseMatrix<double,s> uncompressed(m);
+    uncompressed.uncompress();
+    bool valid= mv.is_compressed() && mv.values().size()==m.values().size() && dense(mv)==rounded
+                && dense(castValues<V>(uncompressed))==rounded;
+    for(const std::vector<double> &z: {mv*x, parallelProduct(mv, x, 3)}){
+        valid= valid && near(z, y_rounded);
+        for(std::size_t i=0; valid && i<rows; ++i)
+            valid= std::abs(z[i]-y[i]) <= bound[i];
+    }
+    return valid;
+}
+
+//a corrupt snapshot is rejected when it is opened, also without the checksum: decreasing m_inner, an index of m_outer out of
+//the matrix, a number of rows that wraps the size of m_inner around
+bool checkCorruptSnapshots(){
+    std::mt19937 gen(12);
+    SparseMatrix<double,StorageOrder::row_wise> m(30, 20);
+    std::vector<Triplet<double>> triplets= randomTriplets(30, 20, 100, gen);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::filesystem::path file= std::filesystem::temp_directory_path()/"algebra_corrupt.snap";
+    if(!writeSnapshot(m, file.string()))
+        return false;
+    std::string bytes;
+    {
+        std::ifstream in(file, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    detail::SnapshotHeader header;
+    std::memcpy(&header, bytes.data(), sizeof(header));
+
+    auto opens= [&](const std::string &content){
+        std::ofstream(file, std::ios::binary).write(content.data(), content.size());
+        return MappedSparseMatrix<double,StorageOrder::row_wise>(file.string()).is_open();
+    };
+    auto corrupt= [&](std::uint64_t offset, std::size_t value){
+        std::string content= bytes;
+        std::memcpy(content.data()+offset, &value, sizeof(value));
+        return content;
+    };
+    bool valid= opens(bytes);
+    //m_inner[2] after m_inner[3], the total stays the same
+    std::size_t inner2, inner3;
+    std::memcpy(&inner2, bytes.data()+header.inner_offset+2*sizeof(std::size_t), sizeof(std::size_t));
+    std::memcpy(&inner3, bytes.data()+header.inner_offset+3*sizeof(std::size_t), sizeof(std::size_t));
+    valid= valid && inner2<inner3 && !opens(corrupt(header.inner_offset+2*sizeof(std::size_t), inner3+1));
+    valid= valid && !opens(corrupt(header.outer_offset+5*sizeof(std::size_t), 20));
+    valid= valid && !opens(corrupt(offsetof(detail::SnapshotHeader, rows), std::numeric_limits<std::size_t>::max()));
+    std::filesystem::remove(file);
+    return valid;
+}
+
+//minimal JSON syntax check: objects, arrays, strings without escapes, numbers, true, false and null
+bool parseJson(const std::string &text, std::size_t &pos){
+    auto skip= [&](){ while(pos<text.size() && std::isspace(static_cast<unsigned char>(text[pos]))) ++pos; };
+    auto literal= [&](const std::string &word){ bool found= text.compare(pos, word.size(), word)==0; pos+= found ? word.size() : 0; return found; };
+    auto string= [&](){
+        if(pos>=text.size() || text[pos]!='"')
+            return false;
+        std::size_t end= text.find('"', pos+1);
+        pos= end==std::string::npos ? text.size() : end+1;
+        return end!=std::string::npos;
+    };
+    skip();
+    if(pos>=text.size())
+        return false;
+    char c= text[pos];
+    if(c=='{' || c=='['){
+        char close= c=='{' ? '}' : ']';
+        ++pos;
+        skip();
+        if(pos<text.size() && text[pos]==close)
+            return ++pos, true;
+        while(true){
+            skip();
+            if(c=='{'){
+                if(!string())
+                    return false;
+                skip();
+                if(pos>=text.size() || text[pos++]!=':')
+                    return false;
+            }
+            if(!parseJson(text, pos))
+                return false;
+            skip();
+            if(pos<text.size() && text[pos]==',')
+                ++pos;
+            else
+                return pos<text.size() && text[pos++]==close;
+        }
+    }
+    if(c=='"')
+        return string();
+    if(literal("true") || literal("false") || literal("null"))
+        return true;
+    char *end= nullptr;
+    std::strtod(text.c_str()+pos, &end);
+    if(end==text.c_str()+pos)
+        return false;
+    pos= end-text.c_str();
+    return true;
+}
+
+bool validJson(const std::string &text){
+    std::size_t pos= 0;
+    if(!parseJson(text, pos))
+        return false;
+    while(pos<text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+        ++pos;
+    return pos==text.size();
+}
+
+//out-of-core products with the smallest budget: the full row and column do not fit in a panel and are split,
+//gemv with and without the transpose against the dense product
+template <StorageOrder s>
+bool checkStreaming(){
+    std::mt19937 gen(16);
+    std::size_t rows= 300, cols= 250;
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 2000, gen);
+    for(std::size_t j=0; j<cols; ++j)
+        triplets.push_back({7, j, 1.+j});
+    for(std::size_t i=0; i<rows; ++i)
+        triplets.push_back({i, 3, 2.-i});
+    SparseMatrix<double,s> m(rows, cols);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<std::vector<double>> a= dense(m), at(cols, std::vector<double>(rows));
+    for(std::size_t i=0; i<rows; ++i)
+        for(std::size_t j=0; j<cols; ++j)
+            at[j][i]= a[i][j];
+    std::filesystem::path file= std::filesystem::temp_directory_path()/"algebra_streaming.snap";
+    if(!writeSnapshot(m, file.string()))
+        return false;
+
+    bool valid;
+    {
+        StreamingSparseMatrix<double,s> streaming(file.string(), 4096);
+        //a panel holds at most 2048 bytes, 128 elements with their indexes, less than the full row or column
+        valid= streaming.is_open() && streaming.panels() > m.values().size()*16/2048;
+        std::vector<double> x= randomValues(cols, gen);
+        valid= valid && near(streaming*x, denseProduct(a, x));
+        for(bool transpose: {false, true}){
+            const auto &op= transpose ? at : a;
+            std::size_t n_in= transpose ? rows : cols, n_out= transpose ? cols : rows;
+            std::vector<double> v= randomValues(n_in, gen), y= randomValues(n_out, gen), expected= denseProduct(op, v);
+            for(std::size_t i=0; i<n_out; ++i)
+                expected[i]= 2.*expected[i] - y[i];
+            valid= valid && gemv(2., streaming, v, -1., y, transpose) && near(y, expected);
+        }
+    }
+    std::filesystem::remove(file);
+    return valid;
+}
+
+//counters of instrumentation.hpp after a known sequence of operations on this thread (make instrumented); without
+//ALGEBRA_INSTRUMENTATION they stay at zero
+bool checkInstrumentation(){
+    using namespace instrumentation;
+    reset();
+    SparseMatrix<double,StorageOrder::row_wise> m(10, 10);
+    std::vector<Triplet<double>> triplets= {{0, 0, 1.}, {3, 4, 2.}, {9, 9, 3.}};
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));   //compressed: toCompressed
+    m.resize(12, 12);                                                   //resizeUncompress and toUncompressed
+    m.compress();                                                       //toCompressed
+    m(11, 11)= 4.;                                                      //two insertions in the compressed matrix
+    m(0, 11)= 5.;
+    m(3, 4)= 6.;                                                        //stored element
+    m.finalize();
+    std::vector<double> y= m*std::vector<double>(12, 1.);
+    Report report= snapshot();
+
+    std::filesystem::path file= std::filesystem::temp_directory_path()/"algebra_instrumentation.json";
+    bool written= writeJson(file.string());
+    std::string json;
+    {
+        std::ifstream in(file);
+        json.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    std::filesystem::remove(file);
+    bool valid= written && validJson(json) && validJson(report.toJson()) && !validJson(report.toJson()+"}")
+                && report.toJson().find(enabled ? "\"enabled\": true" : "\"enabled\": false")!=std::string::npos;
+
+    if constexpr (!enabled){
+        for(std::size_t k=0; k<n_operations; ++k)
+            valid= valid && report.operations[k].calls==0;
+        return valid;
+    }
+    return valid && y[0]==6. && report[Operation::setFromTriplets].calls==1 && report[Operation::toCompressed].calls==2
+           && report[Operation::resizeUncompress].calls==1 && report[Operation::toUncompressed].calls==1
+           && report[Operation::insertCompressed].calls==2 && report[Operation::finalize].calls==1
+           && report[Operation::finalize].elements>0 && report[Operation::product].calls>=1
+           && report[Operation::setFromTriplets].elements==3;
+}
+
+//multiply with k vectors stored row by row and column by column: every column of the result is the product of the matrix
+//with the corresponding vector, for a width with its own kernel (8) and a generic one (5), also uncompressed and with
+//pending insertions
+template <StorageOrder s>
+bool checkMultiply(){
+    std::mt19937 gen(13);
+    std::size_t rows= 47, cols= 31;
+    SparseMatrix<double,s> m(rows, cols);
+    std::vector<Triplet<double>> triplets= randomTriplets(rows, cols, 300, gen);
+    m.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    SparseMatrix<double,s> uncompressed(m), pending(m);
+    uncompressed.uncompress();
+    for(const auto &t: randomTriplets(rows, cols, 40, gen))
+        pending(t.row, t.col)+= t.value;
+
+    bool valid= pending.pending()>0;
+    for(const SparseMatrix<double,s> *a: {&m, &uncompressed, &pending}){
+        std::vector<std::vector<double>> d= dense(*a);
+        for(std::size_t k: {std::size_t(8), std::size_t(5)}){
+            std::vector<std::vector<double>> x(k);
+            for(auto &v: x)
+                v= randomValues(cols, gen);
+            for(StorageOrder layout: {StorageOrder::row_wise, StorageOrder::column_wise}){
+                bool by_rows= layout==StorageOrder::row_wise;
+                std::vector<double> X(cols*k);
+                for(std::size_t c=0; c<k; ++c)
+                    for(std::size_t j=0; j<cols; ++j)
+                        X[by_rows ? j*k+c : c*cols+j]= x[c][j];
+                std::vector<double> Y= multiply(*a, X, k, layout);
+                valid= valid && Y.size()==rows*k;
+                for(std::size_t c=0; valid && c<k; ++c){
+                    std::vector<double> yc(rows), expected= denseProduct(d, x[c]);
+                    for(std::size_t i=0; i<rows; ++i)
+                        yc[i]= Y[by_rows ? i*k+c : c*rows+i];
+                    valid= near(yc, expected) && near(yc, *a*x[c]);
+                }
+            }
+        }
+    }
+    //X with the size of another k
+    return valid && multiply(m, std::vector<double>(cols*3), 4, StorageOrder::row_wise).empty();
+}
+
+//products with a shape chosen at compile time against operator*; a matrix of one column times a vector of one element is
+//a matrix-vector product, times a vector of one element per row it is the dot product
+template <StorageOrder s>
+bool checkShapes(){
+    std::mt19937 gen(14);
+    std::size_t n= 37;
+    SparseMatrix<double,s> square(n, n), rectangular(n, n+3), column(n, 1);
+    std::vector<Triplet<double>> triplets= randomTriplets(n, n, 200, gen);
+    square.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    triplets= randomTriplets(n, n+3, 200, gen);
+    rectangular.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    triplets= randomTriplets(n, 1, 20, gen);
+    column.setFromTriplets(std::span<const Triplet<double>>(triplets));
+    std::vector<double> x= randomValues(n, gen), xr= randomValues(n+3, gen), one= {2.5};
+
+    std::vector<std::vector<double>> dc= dense(column);
+    double expected_dot= 0;
+    std::vector<double> scaled(n);
+    for(std::size_t i=0; i<n; ++i){
+        expected_dot+= dc[i][0]*x[i];
+        scaled[i]= dc[i][0]*2.5;
+    }
+    auto dot_near= [](double a, double b){ return std::abs(a-b) <= 1e-12*std::max(1., std::abs(b)); };
+    bool valid= near(product<SquareShape>(square, x), square*x) && near(product<SquareShape>(square, x), denseProduct(dense(square), x))
+                && near(product<GenericShape>(rectangular, xr), rectangular*xr) && near(rectangular*xr, denseProduct(dense(rectangular), xr))
+                && near(product<ColumnShape>(column, x), {expected_dot}) && near(column*x, {expected_dot})
+                && dot_near(dot(column, x), expected_dot)
+                //n x 1 times a vector of one element: n elements, not a dot product reading past the vector
+                && near(column*one, scaled) && near(product<GenericShape>(column, one), scaled);
+
+    //uncompressed state and pending insertion
+    SparseMatrix<double,s> uncompressed(column);
+    uncompressed.uncompress();
+    std::size_t empty_row= std::ranges::find(dc, std::vector<double>{0.})-dc.begin();
+    if(empty_row==n)
+        return false;
+    column(empty_row, 0)= 1.;
+    valid= valid && column.pending()==1 && dot_near(dot(uncompressed, x), expected_dot) && dot_near(dot(column, x), expected_dot+x[empty_row]);
+
+    //incompatible shapes: empty result, 0 for dot
+    return valid && product<SquareShape>(rectangular, xr).empty() && product<SquareShape>(square, one).empty()
+           && product<ColumnShape>(square, x).empty() && product<ColumnShape>(column, one).empty() && dot(column, one)==0.
+           && dot(square, x)==0.;
+}
+
+}
+
 
 int main(){
 
@@ -42,8 +861,157 @@ int main(){
     Time.stop();
     std::cout << "Product of compressed matrix (column_wise) with vector:       " << Time << std::endl;
 
-    if(prod1==prod2 && prod1==prod3 && prod1==prod4)
-        std::cout << "All products are equal\n\n";
+    Time.start();
+    std::vector<double> prod5=parallelProduct(M_rows,randomVector);
+    Time.stop();
+    std::cout << "Parallel product of compressed matrix (row_wise) with vector: " << Time << std::endl;
+
+    Time.start();
+    std::vector<double> prod6=parallelProduct(M_cols,randomVector);
+    Time.stop();
+    std::cout << "Parallel product of compressed matrix (column_wise) with vector: " << Time << std::endl;
+
+    //the SIMD kernels and the parallel CSC product sum in a different order
+    auto close= [&](const std::vector<double> &a){
+        for(std::size_t i=0; i<a.size(); ++i)
+            if(std::abs(a[i]-prod1[i]) > 1e-12*std::max(1.,std::abs(prod1[i])))
+                return false;
+        return a.size()==prod1.size();
+    };
+    if(close(prod2) && close(prod3) && close(prod4))
+        std::cout << "All products are equal (kernels: " << simd::isaName(simd::activeIsa()) << ")\n";
+    if(close(prod5) && close(prod6))
+        std::cout << "Parallel products match the serial ones\n\n";
+
+    check(checkSetFromTriplets<StorageOrder::row_wise>() && checkSetFromTriplets<StorageOrder::column_wise>(),
+          "setFromTriplets merges repeated entries, skips the ones out of range, gives the same matrix on 4 threads"
+          " and leaves the matrix empty if the entries do not fit in the index type\n");
+
+    check(checkPendingInsertions<StorageOrder::row_wise,MapAssembly>() && checkPendingInsertions<StorageOrder::column_wise,MapAssembly>()
+          && checkPendingInsertions<StorageOrder::row_wise,HashAssembly>(),
+          "Insertions into a compressed matrix are read and printed before finalize() and merged by it\n");
+
+    check(checkGemv<StorageOrder::row_wise>() && checkGemv<StorageOrder::column_wise>(),
+          "gemv computes alpha*A*x+beta*y and the transpose, also with strided vectors and NaN in y when beta is 0\n");
+
+    check(checkMultiply<StorageOrder::row_wise>() && checkMultiply<StorageOrder::column_wise>(),
+          "multiply with 8 and 5 vectors in both layouts matches the products with the single vectors\n");
+
+    check(checkShapes<StorageOrder::row_wise>() && checkShapes<StorageOrder::column_wise>(),
+          "product<SquareShape>, product<ColumnShape> and dot match operator*, an n x 1 matrix times one element gives n, wrong shapes are rejected\n");
+
+    check(checkBlockSparse<StorageOrder::row_wise,3,2>() && checkBlockSparse<StorageOrder::column_wise,3,2>()
+          && checkBlockSparse<StorageOrder::row_wise,4,4>(),
+          "The block format (3x2 and 4x4 blocks, partial edge blocks) matches the matrix and converts back to it\n");
+
+    check(checkSell<StorageOrder::row_wise>() && checkSell<StorageOrder::column_wise>(),
+          "SELL-8-sigma (sigma 1, 8 and all the rows) matches the matrix, with the expected padding, also with empty rows and NaN in x\n");
+
+    check(checkSparseProduct<StorageOrder::row_wise,StorageOrder::row_wise>() && checkSparseProduct<StorageOrder::column_wise,StorageOrder::column_wise>()
+          && checkSparseProduct<StorageOrder::row_wise,StorageOrder::column_wise>() && checkSparseProduct<StorageOrder::column_wise,StorageOrder::row_wise>(),
+          "sparseProduct matches the dense product in every pair of storage orders, also with 32-bit indexes, uncompressed operands and pending insertions\n");
+
+    check(checkReorder<StorageOrder::row_wise>() && checkReorder<StorageOrder::column_wise>(),
+          "reorder gives a permutation and its inverse, the permuted product matches, permute rejects non-permutations\n");
+
+    check(checkSymmetric<StorageOrder::row_wise>() && checkSymmetric<StorageOrder::column_wise>(),
+          "Symmetric files are mirrored by the readers, SymmetricSparseMatrix products and conversions match the full matrix\n");
+
+    check(checkBfloat16Rounding(), "bfloat16 rounds to nearest with ties to even and keeps NaN and infinity");
+    check(checkMixedPrecision<float,StorageOrder::row_wise>(0x1p-24) && checkMixedPrecision<float,StorageOrder::column_wise>(0x1p-24)
+          && checkMixedPrecision<bfloat16,StorageOrder::row_wise>(0x1p-8) && checkMixedPrecision<bfloat16,StorageOrder::column_wise>(0x1p-8),
+          "Products with the values in float and bfloat16 match the double product within their precision\n");
+
+    check(checkInstrumentation(), instrumentation::enabled ? "The instrumentation counters match the operations and export valid JSON\n"
+                                                           : "The instrumentation is disabled, its counters stay at zero and export valid JSON\n");
+
+    //non-owning view of the compressed vectors, no copy
+    SparseMatrixView<double,StorageOrder::row_wise> M_view= M_rows;
+    check(close(M_view*randomVector), "The product of the view matches the serial one\n");
+
+    //the cursor remembers the last position: walking a row costs O(1) per element
+    SparseMatrixCursor M_cursor(M_view);
+    bool cursor_equal= true;
+    for(std::size_t i=0; i<M_rows.rows(); ++i)
+        for(std::size_t j=0; j<M_rows.cols(); ++j)
+            cursor_equal= cursor_equal && M_cursor(i,j)==M_view(i,j);
+    check(cursor_equal, "The elements read with the cursor match the ones of the view\n");
+
+    //32-bit indexes halve the memory read for m_inner and m_outer
+    SparseMatrix<double,StorageOrder::row_wise,std::uint32_t> M_rows32= changeIndexType<std::uint32_t>(M_rows);
+    Time.start();
+    std::vector<double> prod7=M_rows32*randomVector;
+    Time.stop();
+    std::cout << "Product of compressed matrix (row_wise, 32-bit indexes) with vector: " << Time << std::endl;
+    check(close(prod7), "The product with 32-bit indexes matches the serial one\n");
+
+    //flat hash table instead of the ordered map for the uncompressed state
+    SparseMatrix<double,StorageOrder::row_wise,std::size_t,HashAssembly> M_hash=
+        readMatrixMarket<double,StorageOrder::row_wise,std::size_t,HashAssembly>("Insp_131.mtx");
+    Time.start();
+    std::vector<double> prod8=M_hash*randomVector;
+    Time.stop();
+    std::cout << "Product of uncompressed matrix (row_wise, hash assembly) with vector: " << Time << std::endl;
+    check(close(prod8), "The product with hash assembly matches the serial one");
+    check(referencesSurviveCopy<MapAssembly>(), "References into a copied matrix (map assembly) survive new insertions");
+    check(referencesSurviveCopy<HashAssembly>(), "References into a copied matrix (hash assembly) survive new insertions");
+    check(referencesSurviveMove<MapAssembly>() && referencesSurviveMove<HashAssembly>(),
+          "References into a moved matrix survive the move assignment, with both assembly backends");
+    check(checkAssemblyArena<MapAssembly>() && checkAssemblyArena<HashAssembly>(),
+          "A matrix assembled in an AssemblyArena leaves no live allocation once compressed\n");
+
+    Time.start();
+    SparseMatrix<double,StorageOrder::row_wise> M_mapped= readMatrixMarketMapped<double,StorageOrder::row_wise>("Insp_131.mtx");
+    Time.stop();
+    std::cout << "Reading of compressed matrix (row_wise) through memory mapping:   " << Time << std::endl;
+    check(M_mapped.is_compressed() && close(M_mapped*randomVector), "The mapped matrix matches the one read with readMatrixMarket\n");
+
+    //binary snapshot: the compressed vectors are mapped as they are, without parsing
+    const bool snapshot_written= writeSnapshot(M_rows,"Insp_131.snap");
+    check(snapshot_written, "The snapshot of the matrix is written");
+    if(snapshot_written){
+        Time.start();
+        MappedSparseMatrix<double,StorageOrder::row_wise> M_snapshot("Insp_131.snap");
+        Time.stop();
+        std::cout << "Loading of compressed matrix (row_wise) from a binary snapshot:   " << Time << std::endl;
+        check(M_snapshot.is_open() && close(M_snapshot*randomVector), "The snapshot matrix matches the one read with readMatrixMarket");
+        //the checksum is checked only on request, it reads the whole file
+        check(MappedSparseMatrix<double,StorageOrder::row_wise>("Insp_131.snap", true).is_open(), "The checksum of the snapshot is correct\n");
+        check(checkCorruptSnapshots(), "Snapshots with corrupt indexes or dimensions are rejected when opened\n");
+        //out-of-core product, the snapshot is read in panels of at most 4 KiB
+        StreamingSparseMatrix<double,StorageOrder::row_wise> M_streaming("Insp_131.snap", 8192);
+        Time.start();
+        std::vector<double> prod9=M_streaming*randomVector;
+        Time.stop();
+        std::cout << "Product of compressed matrix (row_wise) streamed from a snapshot in " << M_streaming.panels() << " panels: " << Time << std::endl;
+        check(close(prod9), "The streamed product matches the serial one");
+        check(checkStreaming<StorageOrder::row_wise>() && checkStreaming<StorageOrder::column_wise>(),
+              "Streamed products and gemv with the transpose match the dense product, also with a row and a column split across panels\n");
+        std::remove("Insp_131.snap");
+    }
+
+    //A^T*v without building the transpose (CSR scatters, CSC gathers)
+    Time.start();
+    std::vector<double> prodT1=transposeProduct(M_rows,randomVector);
+    Time.stop();
+    std::cout << "Product of the transpose of compressed matrix (row_wise):      " << Time << std::endl;
+
+    Time.start();
+    SparseMatrix<double,StorageOrder::column_wise> M_converted= changeStorageOrder(M_rows);
+    Time.stop();
+    std::cout << "Conversion of compressed matrix from row_wise to column_wise:  " << Time << std::endl;
+    std::vector<double> prodT2=transpose(M_converted)*randomVector;
+    std::vector<double> prodT3=transposeProduct(M_cols,randomVector);
+    //dense reference of the transpose
+    std::vector<std::vector<double>> M_dense= dense(M_rows), M_transposed(M_rows.cols(), std::vector<double>(M_rows.rows()));
+    for(std::size_t i=0; i<M_rows.rows(); ++i)
+        for(std::size_t j=0; j<M_rows.cols(); ++j)
+            M_transposed[j][i]= M_dense[i][j];
+    std::vector<double> prodT= denseProduct(M_transposed, randomVector);
+    check(near(prodT1, prodT) && near(prodT2, prodT) && near(prodT3, prodT),
+          "Products with the transpose (CSR, CSC and transposed matrix) match the dense product");
+    check(dense(M_converted)==M_dense && dense(transpose(M_converted))==M_transposed && close(M_converted*randomVector),
+          "The converted matrix and its transpose match the dense matrix\n");
 
 
     /*
@@ -80,5 +1048,5 @@ int main(){
     std::cout << "\n\n";
     */
 
-    return 0;
+    return failures==0 ? 0 : 1;
 };
\ No newline at end of file